@@ -0,0 +1,110 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "rbst.hpp"
+
+/*
+Measures query latency on a heavily churned tree, before and after
+RBST::compact() relocates its nodes into van Emde Boas order.
+
+    ./compact-bench [size] [churn rounds]
+
+Churn is simulated by repeatedly deleting & reinserting random keys while
+other (unrelated) allocations of various sizes come and go, which is what
+scatters nodes across the heap in a long running program. The tree should
+be well beyond the size of the last level cache (the default 2^21 nodes
+take 64 MB) to see the difference. Compile with -O2 -DNDEBUG.
+*/
+
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+const int queries = 1000000;
+
+
+// Average ns per call of `f` over `queries` calls
+template <typename F>
+double timeQueries(F f) {
+    long long sink = 0;
+    Clock::time_point t0 = Clock::now();
+    for (int i = 0; i < queries; ++i)
+        sink += f(i);
+    double ns = chrono::duration<double, nano>(Clock::now() - t0).count();
+    if (sink == 42) cout << ' ';    // Keeps the results alive
+    return ns / queries;
+}
+
+void measure(RBST& tree, const char* label, int keyrange) {
+    mt19937 rng(99);
+    int n = tree.size();
+    vector<int> keys(queries), ranks(queries), ranks2(queries);
+    for (int i = 0; i < queries; ++i) {
+        keys[i] = int(rng() % keyrange) - n;
+        ranks[i] = 1 + rng() % n;
+        ranks2[i] = 1 + rng() % n;
+        if (ranks[i] > ranks2[i]) swap(ranks[i], ranks2[i]);
+    }
+    cout << left << setw(18) << label << right << fixed << setprecision(1)
+         << setw(10) << timeQueries([&](int i) {return tree.rank(keys[i]);})
+         << setw(10) << timeQueries([&](int i) {return tree.select(ranks[i]);})
+         << setw(12) << timeQueries([&](int i) {
+                return tree.rangeSum(ranks[i], ranks2[i]);})
+         << setw(10) << timeQueries([&](int i) {return tree.min() + i;})
+         << '\n';
+}
+
+
+int main(int argc, char* argv[]) {
+    int n = (argc > 1) ? atoi(argv[1]) : (1 << 21);
+    int rounds = (argc > 2) ? atoi(argv[2]) : 3;
+    // Keys centred on 0, so that subtree sums stay well within an int
+    int keyrange = 2 * n;
+    mt19937 rng(1);
+    auto key = [&]() {return int(rng() % keyrange) - n;};
+    RBST tree;
+    while (tree.size() < n)
+        tree.insert(key());
+
+    // Churn : each round replaces half the keys, with unrelated
+    // allocations held in between so freed memory isn't reused in order
+    vector<unique_ptr<char[]>> other(n / 4);
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < n / 2; ++i) {
+            tree.remove(tree.select(1 + rng() % tree.size()));
+            other[rng() % other.size()].reset(new char[16 + rng() % 48]);
+        }
+        while (tree.size() < n)
+            tree.insert(key());
+    }
+    other.clear();
+
+    cout << "Tree of " << n << " keys after " << rounds << " churn rounds\n\n"
+         << left << setw(18) << "ns per query" << right << setw(10) << "rank"
+         << setw(10) << "select" << setw(12) << "rangeSum" << setw(10)
+         << "min" << '\n';
+    measure(tree, "churned", keyrange);
+    int before = tree.rangeSum(1, tree.size());
+
+    Clock::time_point t0 = Clock::now();
+    tree.compact();
+    double ms = chrono::duration<double, milli>(Clock::now() - t0).count();
+    bool same = (tree.size() == n && tree.rangeSum(1, n) == before);
+    measure(tree, "compacted (vEB)", keyrange);
+
+    // Further churn after compacting, reusing slots of the block
+    for (int i = 0; i < n / 8; ++i) {
+        tree.remove(tree.select(1 + rng() % tree.size()));
+        tree.insert(key());
+    }
+    measure(tree, "+ 12.5% churn", keyrange);
+
+    cout << "\ncompact() took " << setprecision(1) << ms << " ms"
+         << (same ? "" : ", CONTENTS CHANGED") << '\n';
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory_resource>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "rbst.hpp"
+
+/*
+Cost of the per-request allocate & release cycle of a tree : every request
+builds a tree of `size` random keys, runs as many rank/select queries, a
+few deletions and then destroys it. The nodes come from
+- the global heap (the default memory resource, ie. new/delete)
+- a monotonic_buffer_resource over a buffer that is reused by every
+  request, and release()d after each one, so nothing is freed piecemeal
+- an unsynchronized_pool_resource, which keeps freed nodes for later ones
+
+    ./pmr-bench [total keys]
+
+Reports ns per request & per key, and calls to the global operator new per
+request. Compile with -O2 -DNDEBUG.
+*/
+
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+
+static long allocations = 0;
+
+void* operator new(size_t n) {
+    ++allocations;
+    if (void* p = malloc(n ? n : 1))
+        return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept {free(p);}
+void operator delete(void* p, size_t) noexcept {free(p);}
+// The default memory resource allocates with the aligned forms
+void* operator new(size_t n, align_val_t a) {
+    ++allocations;
+    if (void* p = aligned_alloc(size_t(a), (max<size_t>(n, 1) + size_t(a) - 1)
+                                           / size_t(a) * size_t(a)))
+        return p;
+    throw bad_alloc();
+}
+void operator delete(void* p, align_val_t) noexcept {free(p);}
+void operator delete(void* p, size_t, align_val_t) noexcept {free(p);}
+
+
+long long sink = 0;
+
+void request(pmr::memory_resource* res, const vector<int>& keys) {
+    RBST tree(res);
+    for (int k : keys)
+        tree.insert(k);
+    int n = tree.size();
+    for (size_t i = 0; i < keys.size(); ++i)
+        sink += tree.rank(keys[i]) + tree.select(1 + int(i) % n);
+    for (size_t i = 0; i < keys.size(); i += 8)
+        tree.remove(keys[i]);
+}
+
+template <typename Release>
+void measure(const string& name, pmr::memory_resource* res, int size, long total,
+             Release release) {
+    int requests = max(1L, total / size);
+    mt19937 rng(size);
+    vector<int> keys(size);
+    for (int& k : keys)
+        k = int(rng() % (4u * size));
+    request(res, keys);     // Warm up
+    release();
+    long a0 = allocations;
+    Clock::time_point t0 = Clock::now();
+    for (int r = 0; r < requests; ++r) {
+        request(res, keys);
+        release();
+    }
+    double ns = chrono::duration<double, nano>(Clock::now() - t0).count();
+    cout << left << setw(28) << name << right << setw(8) << size << fixed
+         << setprecision(0) << setw(14) << ns / requests << setprecision(1)
+         << setw(10) << ns / requests / size << setw(14)
+         << double(allocations - a0) / requests << '\n';
+}
+
+
+int main(int argc, char* argv[]) {
+    long total = (argc > 1) ? atol(argv[1]) : 2000000;
+    cout << left << setw(28) << "resource" << right << setw(8) << "size"
+         << setw(14) << "ns/request" << setw(10) << "ns/key"
+         << setw(14) << "allocs/req" << '\n';
+    // Big enough for the largest request, so monotonic never goes upstream
+    vector<char> buffer(8 << 20);
+    for (int size = 100; size <= 100000; size *= 10) {
+        measure("global heap", pmr::get_default_resource(), size, total, [] {});
+        pmr::monotonic_buffer_resource mono(buffer.data(), buffer.size());
+        measure("monotonic buffer", &mono, size, total, [&] {mono.release();});
+        pmr::unsynchronized_pool_resource pool;
+        measure("unsynchronized pool", &pool, size, total, [] {});
+        cout << '\n';
+    }
+    return (sink == 42);
+}
@@ -1,6 +1,11 @@
+#pragma once
+
 
 #include <stack>
+#include <functional>
 #include <cassert>
+#include <memory_resource>
+#include <new>
 #include <sstream>
 #include <vector>
 #include <stdexcept>
@@ -47,7 +52,7 @@ class TreeNode {
 // (or meant to be one, during intermediate deletion procedures)
 #define isNull(t) (t == nullptr || (t == doubleblack && t->red))
 
-typedef std::vector<TreeNode*>::iterator vi;
+typedef std::pmr::vector<TreeNode*>::iterator vi;
 
 
 
@@ -60,14 +65,37 @@ class RBST {
     void rightRotate(TreeNode*, TreeNode*);
     void printSubtree(std::ostringstream&, const std::string&,
                       const TreeNode*, bool);
-    void maintainRBT_ins(std::vector<TreeNode*>&);
-    void maintainRBT_del(std::vector<TreeNode*>&);
+    void maintainRBT_ins(std::pmr::vector<TreeNode*>&);
+    void maintainRBT_del(std::pmr::vector<TreeNode*>&);
+    void removeNode(std::pmr::vector<TreeNode*>&);
+    void refreshExtremes();
+    TreeNode* buildSubtree(const int*, int, int, int);
+    TreeNode* newNode(int, bool);
+    void freeNode(TreeNode*);
+    TreeNode* allocNodes(int);
+    void freeNodes(TreeNode*, int);
+    void vebLayout(TreeNode*, int, std::pmr::vector<TreeNode*>&);
     int prefixSumSubtree(TreeNode*, int);
 
+    // Where all nodes, and the temporary vectors & stacks, are allocated
+    std::pmr::memory_resource* res;
+    // Branch from the root searched by insert/remove/popMin/popMax. Kept
+    // between calls, so that they stop allocating once it has grown to the
+    // height of the tree
+    std::pmr::vector<TreeNode*> path;
     // There is atmost just 1 temporary doubleblack node at any time
     TreeNode* doubleblack = nullptr;
     // Node returned by the traversal iterator after the end
-    TreeNode* endnode = new TreeNode;
+    TreeNode* endnode;
+    // Nodes holding the smallest & largest keys, kept up to date by
+    // insert/remove so that min/max need no descent
+    TreeNode* minnode = nullptr;
+    TreeNode* maxnode = nullptr;
+    // Contiguous block that compact() relocates all nodes into. Its slots
+    // freed by deletions are chained through `lc` and reused by insertions
+    TreeNode* arena = nullptr;
+    int arenasize = 0;
+    TreeNode* arenafree = nullptr;
 
     public :
         bool insert(int);
@@ -75,9 +103,17 @@ class RBST {
         int rank(int);
         int select(int);
         int rangeSum(int, int);
-
-        RBST() {}
+        int min() const;
+        int max() const;
+        int popMin();
+        int popMax();
+        void buildSorted(const std::vector<int>&);
+        void compact();
+
+        explicit RBST(std::pmr::memory_resource* = nullptr);
         ~RBST();
+        RBST(const RBST&) = delete;
+        RBST& operator=(const RBST&) = delete;
         std::string print();
         int size() {return (root != nullptr)? root->size : 0;}
 
@@ -91,25 +127,77 @@ class RBST {
 
 
 
+/*
+All memory the tree uses (nodes, the block of compact(), and the temporary
+ancestry vectors & traversal stacks) comes from the memory_resource given
+to the constructor, std::pmr::get_default_resource() (ie. new/delete) if
+none is. Eg. trees built while handling one request can take their nodes
+from a std::pmr::monotonic_buffer_resource, which is released all at once
+afterwards. The resource must outlive the tree and its InOrderTraversers.
+*/
+RBST::RBST(std::pmr::memory_resource* r)
+    : res((r != nullptr) ? r : std::pmr::get_default_resource()), path(res) {
+    endnode = allocNodes(1);
+}
+
 RBST::~RBST() {
     // Destructor
-    // Traverse the tree to free all memory allocated with `new`
+    // Traverse the tree to free all memory allocated for the nodes
     if (root != nullptr) {
-        std::stack<TreeNode*> iot;  
+        std::stack<TreeNode*, std::pmr::vector<TreeNode*>> iot {
+            std::pmr::vector<TreeNode*>(res)};
         TreeNode *curr = root, *temp;
         // In-order traversal so that node's children dont need to be
         // accessed after it is deleted (a node is popped only once)
-        while (!iot.empty()) {
+        while (curr != nullptr || !iot.empty()) {
             if (curr != nullptr) {
                 iot.push(curr);
                 curr = curr->lc;
             } else {
                 curr = iot.top(); iot.pop();
-                temp = curr->rc; delete curr; curr = temp;
+                temp = curr->rc; freeNode(curr); curr = temp;
             }
         }
     }
-    delete endnode;
+    freeNodes(arena, arenasize);
+    freeNodes(endnode, 1);
+}
+
+
+TreeNode* RBST::newNode(int x, bool red) {
+    // Reuse a free slot of the compacted block if there is one, so that
+    // nodes inserted after compact() stay close to the others
+    if (arenafree == nullptr)
+        return new (res->allocate(sizeof(TreeNode), alignof(TreeNode)))
+            TreeNode(x, red);
+    TreeNode* t = arenafree;
+    arenafree = t->lc;
+    *t = TreeNode(x, red);
+    return t;
+}
+
+void RBST::freeNode(TreeNode* t) {
+    std::less<TreeNode*> lt;
+    if (arena != nullptr && !lt(t, arena) && lt(t, arena + arenasize)) {
+        t->lc = arenafree;
+        arenafree = t;
+    } else {
+        res->deallocate(t, sizeof(TreeNode), alignof(TreeNode));
+    }
+}
+
+TreeNode* RBST::allocNodes(int n) {
+    // n contiguous default constructed nodes
+    TreeNode* block = static_cast<TreeNode*>(
+        res->allocate(n * sizeof(TreeNode), alignof(TreeNode)));
+    for (int i = 0; i < n; ++i)
+        new (block + i) TreeNode;
+    return block;
+}
+
+void RBST::freeNodes(TreeNode* block, int n) {
+    if (block != nullptr)
+        res->deallocate(block, n * sizeof(TreeNode), alignof(TreeNode));
 }
 
 
@@ -216,14 +304,16 @@ std::string RBST::print() {
 
 bool RBST::insert(int x) {
     if (root==nullptr) {
-        root = new TreeNode(x, false);
+        root = newNode(x, false);
+        minnode = maxnode = root;
         return true;
     }
     TreeNode* t = root;
     // Temporary O(height) auxiliary space during insertion
     // saves us from having to use O(n) space by permanently storing
     // the parent in each node, while keeping O(lg n) time
-    std::vector<TreeNode*> ancestry;
+    std::pmr::vector<TreeNode*>& ancestry = path;
+    ancestry.clear();
     while (t != nullptr) {
         if (t->val == x)
             return false;
@@ -235,9 +325,12 @@ bool RBST::insert(int x) {
     }
 
     t = ancestry.back();
-    TreeNode* n = new TreeNode(x, true);
+    TreeNode* n = newNode(x, true);
     if (x < t->val) t->lc = n; 
     else            t->rc = n;
+    // Rotations only relink nodes, so the cached extremes only change here
+    if (x < minnode->val) minnode = n;
+    if (x > maxnode->val) maxnode = n;
 
     // Adjust augmented sum/size info in nodes above it
     for (vi it=ancestry.begin(); it<ancestry.end(); ++it) {
@@ -253,10 +346,10 @@ bool RBST::insert(int x) {
 }
 
 
-void RBST::maintainRBT_ins(std::vector<TreeNode*>& ancestry) {
+void RBST::maintainRBT_ins(std::pmr::vector<TreeNode*>& ancestry) {
     // Note : ancestry contains all nodes from root till newly 
     // inserted leaf along its branch in sequence
-    if (ancestry.size() < 2)
+    if (ancestry.size() < 3)
         return; // New node does not have grandparent, no possible conflicts
     
     TreeNode *c = ancestry.back(), *u,
@@ -305,7 +398,8 @@ void RBST::maintainRBT_ins(std::vector<TreeNode*>& ancestry) {
 
 bool RBST::remove(int x) {
     TreeNode* t = root;
-    std::vector<TreeNode*> ancestry;
+    std::pmr::vector<TreeNode*>& ancestry = path;
+    ancestry.clear();
     // Temporary O(height) auxiliary space, used similarly as in insertion
     while (t != nullptr) {
         ancestry.push_back(t);  // Search for the node
@@ -318,8 +412,16 @@ bool RBST::remove(int x) {
     }
     if (t==nullptr)
         return false; // Node is not present
+    removeNode(ancestry);
+    return true;
+}
 
 
+void RBST::removeNode(std::pmr::vector<TreeNode*>& ancestry) {
+    // Note : ancestry contains all nodes from root till the node
+    // to be removed (its last element) along its branch in sequence
+    TreeNode* t = ancestry.back();
+
     // In case of 2 non-null children, use in-order successor
     // (will have 1 non-null child at most)
     if (t->lc != nullptr && t->rc != nullptr) {
@@ -338,8 +440,12 @@ bool RBST::remove(int x) {
     }
 
 
+    // The node physically freed below may be one of the cached extremes
+    // (possibly the max, when it was the successor swapped in above)
+    bool extreme = (t == minnode || t == maxnode);
+
     bool simple = false;
-    TreeNode* g = ancestry.end()[-2];
+    TreeNode* g = (ancestry.size() > 1)? ancestry.end()[-2] : nullptr;
     // Simple cases (non-recursive)
     if (t==root && t->lc == nullptr && t->rc == nullptr) {
         root = nullptr;    // Delete root when it is the only node
@@ -377,7 +483,7 @@ bool RBST::remove(int x) {
     }
 
     if (simple) {
-        delete t;
+        freeNode(t);
     } else {
         // The (only) complex case - black leaf node
         assert(t->lc==nullptr && t->rc==nullptr);
@@ -390,11 +496,12 @@ bool RBST::remove(int x) {
                 store whether it should be null (1) or not (0) */
         maintainRBT_del(ancestry);
     }
-    return true;
+    if (extreme)
+        refreshExtremes();
 }
 
 
-void RBST::maintainRBT_del(std::vector<TreeNode*>& ancestry) {
+void RBST::maintainRBT_del(std::pmr::vector<TreeNode*>& ancestry) {
     // The last node is always double black, when called
     TreeNode *u = ancestry.back();
     assert(u == doubleblack);
@@ -435,12 +542,13 @@ void RBST::maintainRBT_del(std::vector<TreeNode*>& ancestry) {
             ancestry.pop_back();
             maintainRBT_del(ancestry);
         }
-        if (! u->red)
-            doubleblack = nullptr;
-        else {
+        // Resolved; also clear the marker when freeing the null leaf, else
+        // a new node allocated at the same address would look null
+        doubleblack = nullptr;
+        if (u->red) {
             if (side) g->lc = nullptr;
             else g->rc = nullptr;
-            delete u;
+            freeNode(u);
         }
     } 
     else if (!p->red && (d==nullptr || !d->red) && (c!=nullptr && c->red)) {
@@ -459,12 +567,13 @@ void RBST::maintainRBT_del(std::vector<TreeNode*>& ancestry) {
             leftRotate(g, a);
         else 
             rightRotate(g, a);
-        if (! u->red)
-            doubleblack = nullptr;
-        else {
+        // Resolved; also clear the marker when freeing the null leaf, else
+        // a new node allocated at the same address would look null
+        doubleblack = nullptr;
+        if (u->red) {
             if (side) g->lc = nullptr;
             else g->rc = nullptr;
-            delete u;
+            freeNode(u);
         }
     }
 }
@@ -494,9 +603,9 @@ int RBST::rank(int x) {
 
 int RBST::select(int r) {
     // Given rank must be in range
-    if (r < 1 || r > root->size) {
+    if (r < 1 || r > size()) {
         throw std::out_of_range("Invalid index " + std::to_string(r) + 
-        ". Extent is 1.." + std::to_string(root->size));
+        ". Extent is 1.." + std::to_string(size()));
     }
     assert(root != nullptr);
     int cr = (root->lc != nullptr)? root->lc->size + 1 : 1;
@@ -514,6 +623,167 @@ int RBST::select(int r) {
 }
 
 
+int RBST::min() const {
+    if (minnode == nullptr)
+        throw std::out_of_range("Tree is empty");
+    return minnode->val;
+}
+
+int RBST::max() const {
+    if (maxnode == nullptr)
+        throw std::out_of_range("Tree is empty");
+    return maxnode->val;
+}
+
+
+int RBST::popMin() {
+    // The minimum is the end of the leftmost branch, so its ancestry is
+    // just that branch and no key comparisons are needed to find it
+    if (root == nullptr)
+        throw std::out_of_range("Tree is empty");
+    std::pmr::vector<TreeNode*>& ancestry = path;
+    ancestry.clear();
+    for (TreeNode* t = root; t != nullptr; t = t->lc)
+        ancestry.push_back(t);
+    assert(ancestry.back() == minnode);
+    int x = minnode->val;
+    removeNode(ancestry);
+    return x;
+}
+
+int RBST::popMax() {
+    if (root == nullptr)
+        throw std::out_of_range("Tree is empty");
+    std::pmr::vector<TreeNode*>& ancestry = path;
+    ancestry.clear();
+    for (TreeNode* t = root; t != nullptr; t = t->rc)
+        ancestry.push_back(t);
+    assert(ancestry.back() == maxnode);
+    int x = maxnode->val;
+    removeNode(ancestry);
+    return x;
+}
+
+
+void RBST::refreshExtremes() {
+    // O(lg n), only needed after removing the node at either extreme
+    minnode = maxnode = root;
+    if (root == nullptr)
+        return;
+    while (minnode->lc != nullptr)
+        minnode = minnode->lc;
+    while (maxnode->rc != nullptr)
+        maxnode = maxnode->rc;
+}
+
+
+void RBST::buildSorted(const std::vector<int>& keys) {
+    // Builds the tree from strictly ascending keys in O(N) time, much
+    // faster than N separate insertions (used when reloading saved trees)
+    if (root != nullptr)
+        throw std::logic_error("buildSorted requires an empty tree");
+    for (size_t i = 1; i < keys.size(); ++i) {
+        if (keys[i-1] >= keys[i])
+            throw std::invalid_argument("Keys must be sorted and unique");
+    }
+    int n = keys.size(), h = 0;
+    while ((2 << h) - 1 < n) ++h;   // Depth of the deepest level
+    // Splitting at the median leaves every null leaf at depth h or h+1,
+    // so colouring only an incomplete deepest level red balances it
+    int reddepth = ((2 << h) - 1 == n) ? -1 : h;
+    root = buildSubtree(keys.data(), n, 0, reddepth);
+    refreshExtremes();
+}
+
+TreeNode* RBST::buildSubtree(const int* keys, int n, int depth, int reddepth) {
+    if (n == 0)
+        return nullptr;
+    int m = n / 2;
+    TreeNode* t = newNode(keys[m], depth == reddepth);
+    t->lc = buildSubtree(keys, m, depth+1, reddepth);
+    t->rc = buildSubtree(keys+m+1, n-m-1, depth+1, reddepth);
+    t->size = n;
+    if (t->lc != nullptr) t->sum += t->lc->sum;
+    if (t->rc != nullptr) t->sum += t->rc->sum;
+    return t;
+}
+
+
+/*
+compact() moves every node into a single new block, in van Emde Boas order :
+the top half of the levels of the tree is laid out first (recursively in
+the same order), followed by each of the subtrees hanging below it. A root
+to leaf path then touches O(log_B N) cache lines/pages for any block size B,
+instead of one per level once churn has scattered the nodes over the heap.
+The tree remains an ordinary RBST afterwards; slots freed by deletions in
+the block are reused by later insertions, and compact() can be called again
+whenever the layout has degraded. It takes O(N) time & space (plus a
+O(log log N) factor for the layout) and invalidates all InOrderTraversers.
+*/
+void RBST::compact() {
+    std::pmr::vector<TreeNode*> order(res);
+    order.reserve(size());
+    int h = 0;
+    for (int n = size(); n > 0; n >>= 1) ++h;
+    vebLayout(root, 2*h, order);   // A RBT's height is at most 2 lg(N+1)
+    assert(int(order.size()) == size());
+
+    TreeNode* block = (order.empty()) ? nullptr : allocNodes(order.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        block[i] = *order[i];
+    // The old nodes' `lc` are free to use as forwarding pointers now, since
+    // the copies in the block hold the original child pointers
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i]->lc = &block[i];
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (block[i].lc != nullptr) block[i].lc = block[i].lc->lc;
+        if (block[i].rc != nullptr) block[i].rc = block[i].rc->lc;
+    }
+    if (root != nullptr) {
+        root = root->lc;
+        minnode = minnode->lc;
+        maxnode = maxnode->lc;
+    }
+
+    // Free the old nodes, those in a previous block all at once
+    TreeNode* oldarena = arena;
+    arena = nullptr;
+    arenafree = nullptr;
+    for (TreeNode* t : order) {
+        std::less<TreeNode*> lt;
+        if (oldarena == nullptr || lt(t, oldarena) || !lt(t, oldarena + arenasize))
+            res->deallocate(t, sizeof(TreeNode), alignof(TreeNode));
+    }
+    freeNodes(oldarena, arenasize);
+    arena = block;
+    arenasize = order.size();
+}
+
+void RBST::vebLayout(TreeNode* t, int h, std::pmr::vector<TreeNode*>& out) {
+    // Appends the nodes at depths 0..h-1 below t, in van Emde Boas order
+    if (t == nullptr)
+        return;
+    if (h == 1) {
+        out.push_back(t);
+        return;
+    }
+    int top = h / 2;
+    vebLayout(t, top, out);
+    // Roots of the bottom subtrees, at depth `top` below t, left to right
+    std::pmr::vector<TreeNode*> bottom(res), level({t}, res);
+    for (int d = 0; d < top && !level.empty(); ++d) {
+        bottom.clear();
+        for (TreeNode* n : level) {
+            if (n->lc != nullptr) bottom.push_back(n->lc);
+            if (n->rc != nullptr) bottom.push_back(n->rc);
+        }
+        level.swap(bottom);
+    }
+    for (TreeNode* n : level)
+        vebLayout(n, h - top, out);
+}
+
+
 int RBST::prefixSumSubtree(TreeNode* n, int j) {
     assert(j >= 1 && j <= n->size);
     if (n==nullptr)
@@ -532,12 +802,12 @@ int RBST::prefixSumSubtree(TreeNode* n, int j) {
 }
 
 int RBST::rangeSum(int i, int j) {
-    if (i < 1 || i > root->size) {
+    if (i < 1 || i > size()) {
         throw std::out_of_range("Invalid start index " + std::to_string(i) + 
-        ". Extent is 1.." + std::to_string(root->size));
-    } else if (j < 1 || j > root->size) {
+        ". Extent is 1.." + std::to_string(size()));
+    } else if (j < 1 || j > size()) {
         throw std::out_of_range("Invalid end index " + std::to_string(j) + 
-        ". Extent is 1.." + std::to_string(root->size));
+        ". Extent is 1.." + std::to_string(size()));
     }
     // Prefixsum takes O(lg n) time, this is the same
     if (i==1) {
@@ -563,7 +833,8 @@ any/all of these iterators that are being used meanwhile
 class RBST::InOrderTraverser {
             
     TreeNode* n;
-    std::stack<TreeNode*> stk;
+    std::pmr::memory_resource* res;
+    std::stack<TreeNode*, std::pmr::vector<TreeNode*>> stk;
     TreeNode* en;
     void send_to_end() {n = en;}
 
@@ -574,6 +845,12 @@ class RBST::InOrderTraverser {
     friend class RBST;
     public :
         InOrderTraverser(const RBST& tree);
+        // Copies keep using the tree's memory resource
+        InOrderTraverser(const InOrderTraverser& o)
+            : n(o.n), res(o.res),
+              stk(o.stk, std::pmr::polymorphic_allocator<TreeNode*>(o.res)),
+              en(o.en) {}
+        InOrderTraverser& operator=(const InOrderTraverser&) = default;
         int& operator*() const {return n->val;}
         InOrderTraverser& operator++();
         InOrderTraverser  operator++(int) {
@@ -582,7 +859,8 @@ class RBST::InOrderTraverser {
 };
 
 
-RBST::InOrderTraverser::InOrderTraverser(const RBST& tree) {
+RBST::InOrderTraverser::InOrderTraverser(const RBST& tree)
+    : res(tree.res), stk(std::pmr::vector<TreeNode*>(tree.res)) {
     en = tree.endnode;
     if (tree.root == nullptr) {
         n = tree.endnode;
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "trace.hpp"
+
+/*
+Records, generates & replays RBST workload traces (see trace.hpp).
+
+    ./replay gen <seed> <count> [binary] > trace   Seeded synthetic workload
+    ./replay record [binary] < input > trace       Capture a test.cpp input
+    ./replay convert [binary] < trace > trace2     Text <-> binary
+    ./replay run [trace]                           Replay & report timings
+
+`record` runs the (MINIMAL_OUTPUT) input of test.cpp against a tree through
+RecordingRBST, so only operations that were actually performed are kept.
+`run` reads the whole trace into memory first, so parsing isn't timed, and
+then reports throughput along with p50/p99/p999 latencies per operation.
+Compile with optimisations (eg. -O2 -DNDEBUG) for meaningful numbers.
+*/
+
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+
+vector<TraceOp> readAll(istream& in) {
+    TraceReader reader(in);
+    vector<TraceOp> ops;
+    TraceOp op;
+    while (reader.read(op) && op.code != OP_EXIT)
+        ops.push_back(op);
+    return ops;
+}
+
+
+long long percentile(const vector<long long>& sorted, double p) {
+    // Nearest-rank percentile of an already sorted sample
+    size_t k = static_cast<size_t>(p * sorted.size());
+    return sorted[std::min(k, sorted.size() - 1)];
+}
+
+
+int run(const vector<TraceOp>& ops) {
+    RBST tree;
+    vector<long long> lat[OP_COUNT];
+    long long sink = 0;     // Consumes results so that no call is elided
+    int failed = 0;
+
+    Clock::time_point begin = Clock::now();
+    for (const TraceOp& op : ops) {
+        Clock::time_point t0 = Clock::now();
+        try {
+            switch (op.code) {
+                case OP_PRINT:    sink += tree.print().size(); break;
+                case OP_INSERT:   sink += tree.insert(op.x); break;
+                case OP_REMOVE:   sink += tree.remove(op.x); break;
+                case OP_RANK:     sink += tree.rank(op.x); break;
+                case OP_SELECT:   sink += tree.select(op.x); break;
+                case OP_RANGESUM: sink += tree.rangeSum(op.x, op.y); break;
+                case OP_SIZE:     sink += tree.size(); break;
+                case OP_TRAVERSE: {
+                    RBST::InOrderTraverser en = tree.end();
+                    for (RBST::InOrderTraverser it = tree.begin(); it != en; ++it)
+                        sink += *it;
+                    break;
+                }
+                case OP_MIN:    sink += tree.min(); break;
+                case OP_MAX:    sink += tree.max(); break;
+                case OP_POPMIN: sink += tree.popMin(); break;
+                case OP_POPMAX: sink += tree.popMax(); break;
+            }
+        } catch (const std::out_of_range&) {
+            ++failed;   // Still timed, the exception is part of its cost
+        }
+        Clock::time_point t1 = Clock::now();
+        lat[op.code].push_back(
+            chrono::duration_cast<chrono::nanoseconds>(t1 - t0).count());
+    }
+    double total = chrono::duration<double>(Clock::now() - begin).count();
+
+    cout << ops.size() << " ops in " << fixed << setprecision(4) << total
+         << " s, " << setprecision(0) << ops.size() / total << " ops/s"
+         << " (final size " << tree.size() << ", " << failed
+         << " out of range, checksum " << sink << ")\n\n";
+    cout << left << setw(10) << "op" << right << setw(10) << "count"
+         << setw(10) << "p50 ns" << setw(10) << "p99 ns" << setw(10)
+         << "p999 ns" << setw(12) << "max ns" << '\n';
+    for (int c = 0; c < OP_COUNT; ++c) {
+        vector<long long>& v = lat[c];
+        if (v.empty())
+            continue;
+        sort(v.begin(), v.end());
+        cout << left << setw(10) << traceOpNames[c] << right
+             << setw(10) << v.size() << setw(10) << percentile(v, 0.50)
+             << setw(10) << percentile(v, 0.99) << setw(10)
+             << percentile(v, 0.999) << setw(12) << v.back() << '\n';
+    }
+    return 0;
+}
+
+
+int record(istream& in, bool binary) {
+    // Same menu loop as test.cpp with MINIMAL_OUTPUT, minus the output
+    RBST tree;
+    TraceWriter writer(cout, binary);
+    RecordingRBST rec(tree, writer);
+    TraceReader reader(in);
+    TraceOp op;
+    while (reader.read(op) && op.code != OP_EXIT) {
+        try {
+            switch (op.code) {
+                case OP_PRINT:    rec.print(); break;
+                case OP_INSERT:   rec.insert(op.x); break;
+                case OP_REMOVE:   rec.remove(op.x); break;
+                case OP_RANK:     rec.rank(op.x); break;
+                case OP_SELECT:   rec.select(op.x); break;
+                case OP_RANGESUM: rec.rangeSum(op.x, op.y); break;
+                case OP_SIZE:     rec.size(); break;
+                case OP_TRAVERSE: writer.write(op); break;
+                case OP_MIN:    rec.min(); break;
+                case OP_MAX:    rec.max(); break;
+                case OP_POPMIN: rec.popMin(); break;
+                case OP_POPMAX: rec.popMax(); break;
+            }
+        } catch (const std::out_of_range&) {}
+    }
+    writer.write({OP_EXIT});
+    return 0;
+}
+
+
+int main(int argc, char* argv[]) {
+    string mode = (argc > 1) ? argv[1] : "";
+    try {
+        if (mode == "gen" && argc >= 4) {
+            bool binary = (argc > 4 && strcmp(argv[4], "binary") == 0);
+            TraceWriter writer(cout, binary);
+            for (const TraceOp& op : generateWorkload(stoul(argv[2]), stoi(argv[3])))
+                writer.write(op);
+            writer.write({OP_EXIT});
+            return 0;
+        } else if (mode == "record") {
+            return record(cin, argc > 2 && strcmp(argv[2], "binary") == 0);
+        } else if (mode == "convert") {
+            TraceWriter writer(cout, argc > 2 && strcmp(argv[2], "binary") == 0);
+            for (const TraceOp& op : readAll(cin))
+                writer.write(op);
+            writer.write({OP_EXIT});
+            return 0;
+        } else if (mode == "run") {
+            if (argc > 2) {
+                ifstream file(argv[2], ios::binary);
+                if (!file) {
+                    cerr << "Cannot open " << argv[2] << '\n';
+                    return 1;
+                }
+                return run(readAll(file));
+            }
+            return run(readAll(cin));
+        }
+    } catch (const std::exception& e) {
+        cerr << e.what() << '\n';
+        return 1;
+    }
+    cerr << "Usage : " << argv[0] << " gen <seed> <count> [binary]\n"
+         << "        " << argv[0] << " record [binary] < input\n"
+         << "        " << argv[0] << " convert [binary] < trace\n"
+         << "        " << argv[0] << " run [trace]\n";
+    return 2;
+}
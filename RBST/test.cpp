@@ -1,7 +1,18 @@
 #include <iostream>
 #include <exception>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <string>
+
+#include <csignal>
+#include <sys/resource.h>
+#include <unistd.h>
 
 #include "rbst.hpp"
+#include "wal.hpp"
 
 #define MINIMAL_OUTPUT
 /* By defining this flag, it is easier to automate operations
@@ -26,7 +37,155 @@ to insert those elements, print the tree and exit
 using namespace std;
 
 
-int main() {
+/*
+Recovery of the write-ahead log (wal.hpp), in a temporary directory :
+    ./test wal
+- A torn tail : garbage appended to the log (a partial record, then a full
+  sized one that fails its checksum) must be cut off, keeping every record
+  before it, and records appended afterwards must be replayed too.
+- A log older than the checkpoint : a crash after the new checkpoint was
+  renamed into place but before the log was truncated leaves the old log,
+  whose records are all in the checkpoint already and must be skipped.
+- A failed write : with the file size limited, a group commit fails after
+  writing part of the group. The op that triggered it must be undone, and
+  the group written in full by the next commit.
+Returns 1 if any check fails.
+*/
+bool sameKeys(DurableRBST& t, const set<int>& keys) {
+    set<int> got;
+    RBST::InOrderTraverser en = t.end();
+    for (RBST::InOrderTraverser it = t.begin(); it != en; ++it)
+        got.insert(*it);
+    return got == keys && t.size() == int(keys.size());
+}
+
+string readFile(const string& path) {
+    ifstream f(path, ios::binary);
+    return string(istreambuf_iterator<char>(f), istreambuf_iterator<char>());
+}
+
+void writeFile(const string& path, const string& data, bool append = false) {
+    ofstream f(path, ios::binary | (append ? ios::app : ios::trunc));
+    f.write(data.data(), data.size());
+}
+
+int walRecoveryTest() {
+    char tmpl[] = "/tmp/rbst-wal-XXXXXX";
+    if (mkdtemp(tmpl) == nullptr) {
+        cerr << "Cannot create a temporary directory\n";
+        return 1;
+    }
+    string dir = tmpl, logpath = dir + "/rbst.wal";
+    WalOptions o;
+    o.fsync = false;
+    o.checkpointEvery = 0;
+    set<int> keys;
+    int failures = 0;
+    auto check = [&](const string& what, bool ok) {
+        cout << what << " : " << (ok ? "ok" : "FAILED") << '\n';
+        failures += !ok;
+    };
+
+    // Torn tail
+    {
+        DurableRBST t(dir, o);
+        for (int i = 1; i <= 100; ++i) {
+            t.insert(i);
+            keys.insert(i);
+        }
+        for (int i = 2; i <= 100; i += 2) {
+            t.remove(i);
+            keys.erase(i);
+        }
+    }
+    long length = readFile(logpath).size();
+    writeFile(logpath, "\x01\x02\x03\x04\x05\x06\x07", true);
+    {
+        DurableRBST t(dir, o);
+        check("partial record", t.recovered == 150 && sameKeys(t, keys) &&
+                                long(readFile(logpath).size()) == length);
+    }
+    writeFile(logpath, string(16, '\x5a') + "+rest", true);
+    {
+        DurableRBST t(dir, o);
+        check("corrupted record", t.recovered == 150 && sameKeys(t, keys) &&
+                                  long(readFile(logpath).size()) == length);
+        t.insert(1000);
+        keys.insert(1000);
+    }
+    {
+        DurableRBST t(dir, o);
+        check("appended after the cut", t.recovered == 151 && sameKeys(t, keys));
+    }
+
+    // Log older than the checkpoint
+    string oldLog;
+    {
+        DurableRBST t(dir, o);
+        t.remove(1);
+        keys.erase(1);
+        t.sync();
+        oldLog = readFile(logpath);
+        t.checkpoint();
+    }
+    writeFile(logpath, oldLog);
+    {
+        DurableRBST t(dir, o);
+        check("log older than the checkpoint", t.recovered == 0 && sameKeys(t, keys));
+        t.insert(-5);
+        t.remove(3);
+        keys.insert(-5);
+        keys.erase(3);
+    }
+    {
+        DurableRBST t(dir, o);
+        check("appended after the old log", t.recovered == 2 && sameKeys(t, keys));
+    }
+
+    // Failed write. Writing past the limit fails with EFBIG (instead of
+    // raising SIGXFSZ) once some of the group made it
+    o.groupSize = 4;
+    {
+        DurableRBST t(dir, o);
+        rlimit lim, old;
+        getrlimit(RLIMIT_FSIZE, &old);
+        lim = old;
+        lim.rlim_cur = readFile(logpath).size() + 40;
+        signal(SIGXFSZ, SIG_IGN);
+        setrlimit(RLIMIT_FSIZE, &lim);
+        for (int i = 2000; i < 2003; ++i) {
+            t.insert(i);
+            keys.insert(i);
+        }
+        bool failed = false;
+        try {
+            t.insert(2003);     // Fills the group
+        } catch (const runtime_error&) {
+            failed = true;
+        }
+        setrlimit(RLIMIT_FSIZE, &old);
+        signal(SIGXFSZ, SIG_DFL);
+        check("failed write undone", failed && sameKeys(t, keys));
+        t.insert(2004);
+        keys.insert(2004);
+        t.sync();
+    }
+    {
+        DurableRBST t(dir, o);
+        check("group written after a failed write", t.recovered == 6 && sameKeys(t, keys));
+    }
+
+    unlink(logpath.c_str());
+    unlink((dir + "/rbst.ckpt").c_str());
+    rmdir(dir.c_str());
+    return (failures > 0);
+}
+
+
+int main(int argc, char* argv[]) {
+
+    if (argc > 1 && strcmp(argv[1], "wal") == 0)
+        return walRecoveryTest();
 
     RBST tree;
 
@@ -71,7 +230,8 @@ int main() {
     do {
         #ifndef MINIMAL_OUTPUT
             std::cout << "Operations :\n[0] Exit\t[1] Print\t[2] Insert\t[3] Delete\t"  << 
-            "[4] Rank\t[5] Select\t[6] RangeSum\t[7] Get Size\t[8] Traverse\nSelect choice - ";
+            "[4] Rank\t[5] Select\t[6] RangeSum\t[7] Get Size\t[8] Traverse\t" <<
+            "[9] Min\t[10] Max\t[11] Pop Min\t[12] Pop Max\nSelect choice - ";
         #endif
         std::cin >> opt;
         switch (opt) {
@@ -131,12 +291,21 @@ int main() {
             case 7:
                 std::cout << tree.size() << '\n';
                 break;
-            case 8:
+            case 8: {
                 RBST::InOrderTraverser en = tree.end();
                 for (RBST::InOrderTraverser it = tree.begin(); it != en; ++it) {
                     std::cout << *it << '\n';
                 }
                 break;
+            }
+            case 9: case 10: case 11: case 12:
+                try {
+                    std::cout << ((opt==9)? tree.min() : (opt==10)? tree.max() :
+                                  (opt==11)? tree.popMin() : tree.popMax()) << '\n';
+                } catch (const std::exception& e) {
+                    std::cerr << e.what() << std::endl;
+                }
+                break;
         }
     } while (opt != 0);
 
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "rbst.hpp"
+
+
+
+/*
+Workload traces for RBST, so that a stream of operations can be recorded
+once and then replayed exactly (see replay.cpp) instead of being regenerated
+randomly on every run.
+
+Operations use the same opcodes as the menu in test.cpp, so a text trace is
+exactly the input that test.cpp reads with MINIMAL_OUTPUT defined :
+one opcode per line, followed by its arguments (if any).
+A binary trace begins with the 4 bytes "RBT1", after which every operation
+is 1 byte of opcode followed by each argument as a 4 byte little-endian int.
+*/
+
+enum TraceOpcode {
+    OP_EXIT = 0, OP_PRINT, OP_INSERT, OP_REMOVE, OP_RANK, OP_SELECT,
+    OP_RANGESUM, OP_SIZE, OP_TRAVERSE, OP_MIN, OP_MAX, OP_POPMIN, OP_POPMAX,
+    OP_COUNT    // Number of opcodes, not an operation itself
+};
+
+const char* const traceOpNames[OP_COUNT] = {
+    "exit", "print", "insert", "remove", "rank", "select",
+    "rangesum", "size", "traverse", "min", "max", "popmin", "popmax"
+};
+
+// Number of int arguments that follow an opcode
+inline int traceArgs(int code) {
+    if (code == OP_RANGESUM)
+        return 2;
+    return (code >= OP_INSERT && code <= OP_SELECT) ? 1 : 0;
+}
+
+struct TraceOp {
+    int code;
+    int x = 0, y = 0;
+};
+
+
+
+
+class TraceWriter {
+
+    std::ostream& out;
+    bool binary;
+    void putInt(int);
+
+    public :
+        TraceWriter(std::ostream& o, bool bin=false) : out(o), binary(bin) {
+            if (binary) out.write("RBT1", 4);
+        }
+        void write(const TraceOp&);
+};
+
+void TraceWriter::putInt(int v) {
+    std::uint32_t u = static_cast<std::uint32_t>(v);
+    char b[4] = {char(u), char(u >> 8), char(u >> 16), char(u >> 24)};
+    out.write(b, 4);
+}
+
+void TraceWriter::write(const TraceOp& op) {
+    int n = traceArgs(op.code);
+    if (binary) {
+        out.put(static_cast<char>(op.code));
+        if (n > 0) putInt(op.x);
+        if (n > 1) putInt(op.y);
+    } else {
+        out << op.code;
+        if (n > 0) out << ' ' << op.x;
+        if (n > 1) out << ' ' << op.y;
+        out << '\n';
+    }
+}
+
+
+
+class TraceReader {
+
+    std::istream& in;
+    bool binary = false;
+    bool getInt(int&);
+
+    public :
+        // The format is detected from the first bytes of the stream
+        TraceReader(std::istream&);
+        bool isBinary() const {return binary;}
+        bool read(TraceOp&);
+};
+
+TraceReader::TraceReader(std::istream& i) : in(i) {
+    if (in.peek() == 'R') {
+        char magic[4];
+        in.read(magic, 4);
+        if (!in || std::string(magic, 4) != "RBT1")
+            throw std::runtime_error("Unrecognised binary trace header");
+        binary = true;
+    }
+}
+
+bool TraceReader::getInt(int& v) {
+    unsigned char b[4];
+    if (!in.read(reinterpret_cast<char*>(b), 4))
+        return false;
+    v = static_cast<int>(std::uint32_t(b[0]) | std::uint32_t(b[1]) << 8 |
+                         std::uint32_t(b[2]) << 16 | std::uint32_t(b[3]) << 24);
+    return true;
+}
+
+bool TraceReader::read(TraceOp& op) {
+    // Returns false at the end of the stream
+    op = TraceOp();
+    if (binary) {
+        int c = in.get();
+        if (c == std::char_traits<char>::eof())
+            return false;
+        op.code = c;
+    } else if (!(in >> op.code)) {
+        return false;
+    }
+    if (op.code < 0 || op.code >= OP_COUNT)
+        throw std::runtime_error("Invalid opcode " + std::to_string(op.code));
+    int n = traceArgs(op.code);
+    bool ok = true;
+    if (binary) {
+        if (n > 0) ok = getInt(op.x);
+        if (n > 1) ok = ok && getInt(op.y);
+    } else {
+        if (n > 0) ok = bool(in >> op.x);
+        if (n > 1) ok = ok && bool(in >> op.y);
+    }
+    if (!ok)
+        throw std::runtime_error("Truncated trace, missing arguments of " +
+                                 std::string(traceOpNames[op.code]));
+    return true;
+}
+
+
+
+
+/*
+Forwards every operation to the wrapped tree, and also writes it to a trace.
+Use this in place of the tree itself to capture the real operation stream
+of an application, which can later be replayed against (modified) versions
+of RBST for timing.
+*/
+class RecordingRBST {
+
+    RBST& tree;
+    TraceWriter& log;
+
+    public :
+        RecordingRBST(RBST& t, TraceWriter& w) : tree(t), log(w) {}
+
+        bool insert(int x) {log.write({OP_INSERT, x}); return tree.insert(x);}
+        bool remove(int x) {log.write({OP_REMOVE, x}); return tree.remove(x);}
+        int rank(int x)    {log.write({OP_RANK, x}); return tree.rank(x);}
+        int select(int r)  {log.write({OP_SELECT, r}); return tree.select(r);}
+        int rangeSum(int i, int j) {
+            log.write({OP_RANGESUM, i, j}); return tree.rangeSum(i, j);
+        }
+        int size()   {log.write({OP_SIZE}); return tree.size();}
+        int min()    {log.write({OP_MIN}); return tree.min();}
+        int max()    {log.write({OP_MAX}); return tree.max();}
+        int popMin() {log.write({OP_POPMIN}); return tree.popMin();}
+        int popMax() {log.write({OP_POPMAX}); return tree.popMax();}
+        std::string print() {log.write({OP_PRINT}); return tree.print();}
+};
+
+
+
+
+/*
+Relative weights of each kind of operation in a synthetic workload, and
+the range [keyMin, keyMax] that keys are drawn from.
+*/
+struct WorkloadMix {
+    int insert = 40, remove = 20, rank = 15, select = 15, rangeSum = 5;
+    int popMin = 0, popMax = 0, min = 5, max = 0;
+    int keyMin = -2000, keyMax = 5500;
+};
+
+/*
+Generates `n` operations reproducibly from `seed`.
+A shadow tree is maintained while generating, so that ranks passed to
+select/rangeSum are always in range and half of all removals target a key
+that is actually present (a uniformly random key would almost always miss
+in a sparse key range). Operations that need a non-empty tree are replaced
+by insertions while the shadow tree is empty.
+*/
+std::vector<TraceOp> generateWorkload(unsigned seed, int n,
+                                      const WorkloadMix& mix = WorkloadMix()) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> key(mix.keyMin, mix.keyMax);
+    std::discrete_distribution<int> kind({
+        double(mix.insert), double(mix.remove), double(mix.rank),
+        double(mix.select), double(mix.rangeSum), double(mix.popMin),
+        double(mix.popMax), double(mix.min), double(mix.max)});
+    const int codes[] = {OP_INSERT, OP_REMOVE, OP_RANK, OP_SELECT,
+        OP_RANGESUM, OP_POPMIN, OP_POPMAX, OP_MIN, OP_MAX};
+
+    RBST shadow;
+    std::vector<TraceOp> ops;
+    ops.reserve(n);
+    auto anyRank = [&]() {
+        return std::uniform_int_distribution<int>(1, shadow.size())(rng);
+    };
+    while (int(ops.size()) < n) {
+        TraceOp op {codes[kind(rng)]};
+        if (shadow.size() == 0 && op.code != OP_REMOVE && op.code != OP_RANK)
+            op.code = OP_INSERT;
+        switch (op.code) {
+            case OP_INSERT:
+                op.x = key(rng); shadow.insert(op.x); break;
+            case OP_REMOVE:
+                op.x = (shadow.size() > 0 && rng() % 2) ?
+                        shadow.select(anyRank()) : key(rng);
+                shadow.remove(op.x); break;
+            case OP_RANK:
+                op.x = key(rng); break;
+            case OP_SELECT:
+                op.x = anyRank(); break;
+            case OP_RANGESUM:
+                op.x = anyRank(); op.y = anyRank();
+                if (op.x > op.y) std::swap(op.x, op.y);
+                break;
+            case OP_POPMIN:
+                shadow.popMin(); break;
+            case OP_POPMAX:
+                shadow.popMax(); break;
+        }
+        ops.push_back(op);
+    }
+    return ops;
+}
@@ -0,0 +1,142 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include <unistd.h>
+
+#include "wal.hpp"
+
+/*
+Measures the cost of the durability layer (wal.hpp) : insert/remove
+throughput of a plain RBST, of DurableRBST without fsync, and of DurableRBST
+at several group commit sizes, followed by the time taken to recover.
+
+    ./wal-bench [ops] [directory]
+
+The directory defaults to a new temporary one under /tmp, and should be on
+the disk being measured. Compile with -O2 -DNDEBUG.
+*/
+
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+
+double seconds(Clock::time_point since) {
+    return chrono::duration<double>(Clock::now() - since).count();
+}
+
+void wipe(const string& dir) {
+    unlink((dir + "/rbst.wal").c_str());
+    unlink((dir + "/rbst.ckpt").c_str());
+}
+
+// Alternating bursts of insertions & deletions over a fixed key range
+template <typename Tree>
+long workload(Tree& tree, int ops) {
+    mt19937 rng(7);
+    uniform_int_distribution<int> key(0, 1 << 20);
+    long changed = 0;
+    for (int i = 0; i < ops; ++i)
+        changed += ((i / 1000) % 3 != 2) ? tree.insert(key(rng)) : tree.remove(key(rng));
+    return changed;
+}
+
+void report(const string& name, int ops, double t) {
+    cout << left << setw(34) << name << right << setw(12) << fixed
+         << setprecision(0) << ops / t << " ops/s" << setw(10)
+         << setprecision(0) << t * 1e9 / ops << " ns/op\n";
+}
+
+
+int main(int argc, char* argv[]) {
+    int ops = (argc > 1) ? atoi(argv[1]) : 200000;
+    string dir;
+    if (argc > 2) {
+        dir = argv[2];
+    } else {
+        char tmpl[] = "/tmp/wal-bench-XXXXXX";
+        if (mkdtemp(tmpl) == nullptr) {
+            cerr << "Cannot create a temporary directory\n";
+            return 1;
+        }
+        dir = tmpl;
+    }
+    cout << ops << " insert/remove operations, files in " << dir << "\n\n";
+
+    {
+        RBST tree;
+        Clock::time_point t0 = Clock::now();
+        workload(tree, ops);
+        report("RBST (no durability)", ops, seconds(t0));
+    }
+    {
+        wipe(dir);
+        WalOptions o; o.fsync = false;
+        DurableRBST tree(dir, o);
+        Clock::time_point t0 = Clock::now();
+        workload(tree, ops);
+        tree.sync();
+        report("DurableRBST, no fsync", ops, seconds(t0));
+    }
+    for (int group : {1, 16, 256, 4096}) {
+        wipe(dir);
+        WalOptions o; o.groupSize = group;
+        o.groupDelay = chrono::seconds(10);  // Only the group size matters here
+        DurableRBST tree(dir, o);
+        // fsync per op is slow, so that case is only run on a sample
+        int n = (group == 1) ? min(ops, 2000) : ops;
+        Clock::time_point t0 = Clock::now();
+        workload(tree, n);
+        tree.sync();
+        report("DurableRBST, group commit " + to_string(group), n, seconds(t0));
+    }
+
+    cout << '\n';
+    {
+        // Only a log : every record is replayed
+        wipe(dir);
+        WalOptions o; o.checkpointEvery = 0;
+        int size;
+        {
+            DurableRBST tree(dir, o);
+            workload(tree, ops);
+            size = tree.size();
+        }
+        Clock::time_point t0 = Clock::now();
+        DurableRBST tree(dir, o);
+        double t = seconds(t0);
+        cout << "Recovery from log only     : " << setprecision(4) << t * 1e3
+             << " ms, " << tree.recovered << " records replayed, size "
+             << tree.size() << ((tree.size() == size) ? "" : " MISMATCH") << '\n';
+    }
+    {
+        // Checkpoint taken at 90% of the operations : only the tail is replayed
+        wipe(dir);
+        WalOptions o; o.checkpointEvery = 0;
+        int size;
+        {
+            DurableRBST tree(dir, o);
+            workload(tree, ops - ops / 10);
+            tree.checkpoint();
+            mt19937 rng(11);
+            for (int i = 0; i < ops / 10; ++i)
+                tree.insert(rng() % (1 << 20));
+            size = tree.size();
+        }
+        Clock::time_point t0 = Clock::now();
+        DurableRBST tree(dir, o);
+        double t = seconds(t0);
+        cout << "Recovery from checkpoint   : " << setprecision(4) << t * 1e3
+             << " ms, " << tree.recovered << " records replayed, size "
+             << tree.size() << ((tree.size() == size) ? "" : " MISMATCH") << '\n';
+    }
+    if (argc <= 2) {
+        wipe(dir);
+        rmdir(dir.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,422 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "rbst.hpp"
+
+
+
+/*
+Optional durability layer for RBST, using plain local files in a directory :
+- `rbst.wal`  : Write-ahead log, one fixed size record per insert/remove
+                that changed the tree
+- `rbst.ckpt` : Latest checkpoint, all keys of the tree in ascending order
+
+Every record carries an increasing sequence number, and the checkpoint
+stores the sequence number of the last operation it contains. Recovery loads
+the checkpoint in O(N) (RBST::buildSorted) and replays only the records in
+the log after it, so a crash between writing a checkpoint and truncating
+the log is harmless. A torn record at the end of the log (crash in the
+middle of a write) fails its checksum, and the log is cut off before it.
+
+Group commit : records are buffered in memory and written with a single
+write + fdatasync once `groupSize` operations are pending, or once the
+oldest pending one has waited `groupDelay` (checked on the next operation,
+there is no background thread). Call sync() to make everything durable
+immediately, eg. before acknowledging a batch to a client. An operation is
+therefore only guaranteed to survive a crash once it has been synced.
+
+Errors from the filesystem are thrown as std::runtime_error. An operation
+that throws is undone, so it's neither in the tree nor (ever) in the log. A
+group that fails to be written is cut off the log again, and stays pending
+for the next attempt.
+*/
+
+struct WalOptions {
+    int groupSize = 64;
+    std::chrono::microseconds groupDelay {2000};
+    // Checkpoint after this many logged operations, 0 to only do so manually
+    long checkpointEvery = 1 << 20;
+    // Disabling fsync keeps the log but makes it survive only process
+    // crashes, not power loss (also useful to measure the cost of fsync)
+    bool fsync = true;
+};
+
+
+
+class DurableRBST {
+
+    using Clock = std::chrono::steady_clock;
+    static const int recordSize = 16;
+
+    RBST tree;
+    WalOptions opt;
+    std::string dir, logpath, ckptpath;
+    int logfd = -1;
+    off_t logSize = 0;          // Bytes of the log written so far
+
+    std::vector<char> pending;  // Encoded records not yet written
+    int npending = 0;
+    Clock::time_point oldest;   // When the first pending record was added
+    std::uint64_t seq = 0;      // Sequence number of the last logged op
+    long sinceCkpt = 0;
+
+    void checkpointIfDue();
+    void log(char, int);
+    void recover();
+    long replayLog();
+    void flush();
+    [[noreturn]] void fail(const std::string&);
+
+    public :
+        DurableRBST(const std::string& dir, WalOptions o = WalOptions());
+        ~DurableRBST();
+        DurableRBST(const DurableRBST&) = delete;
+        DurableRBST& operator=(const DurableRBST&) = delete;
+
+        bool insert(int);
+        bool remove(int);
+        int popMin();
+        int popMax();
+        void sync();
+        void checkpoint();
+
+        // Queries don't touch the log
+        int rank(int x) {return tree.rank(x);}
+        int select(int r) {return tree.select(r);}
+        int rangeSum(int i, int j) {return tree.rangeSum(i, j);}
+        int min() const {return tree.min();}
+        int max() const {return tree.max();}
+        int size() {return tree.size();}
+        std::string print() {return tree.print();}
+        RBST::InOrderTraverser begin() const {return tree.begin();}
+        RBST::InOrderTraverser end() const {return tree.end();}
+
+        // Number of log records replayed by recovery, when constructed
+        long recovered = 0;
+};
+
+
+// FNV-1a, to detect torn or corrupted records & checkpoints
+inline std::uint32_t walChecksum(const char* p, size_t n) {
+    std::uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; ++i)
+        h = (h ^ static_cast<unsigned char>(p[i])) * 16777619u;
+    return h;
+}
+
+// Records & checkpoints are written in the machine's byte order, a
+// checkpoint isn't meant to be moved across architectures
+template <typename T>
+inline void walPut(std::vector<char>& buf, T v) {
+    const char* p = reinterpret_cast<const char*>(&v);
+    buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+template <typename T>
+inline T walGet(const char* p) {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+
+
+
+DurableRBST::DurableRBST(const std::string& d, WalOptions o)
+        : opt(o), dir(d), logpath(d + "/rbst.wal"), ckptpath(d + "/rbst.ckpt") {
+    recover();
+    logfd = ::open(logpath.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (logfd < 0)
+        fail("Cannot open " + logpath);
+    logSize = ::lseek(logfd, 0, SEEK_END);
+    if (logSize < 0)
+        fail("Cannot seek " + logpath);
+    pending.reserve(recordSize * opt.groupSize);
+}
+
+DurableRBST::~DurableRBST() {
+    // Destructors can't throw, a failed final sync loses the pending tail
+    // exactly like a crash would
+    try {
+        sync();
+    } catch (const std::runtime_error&) {}
+    if (logfd >= 0)
+        ::close(logfd);
+}
+
+void DurableRBST::fail(const std::string& what) {
+    throw std::runtime_error(what + " : " + std::strerror(errno));
+}
+
+
+
+
+void DurableRBST::recover() {
+    // Load the checkpoint, if any :
+    // "RBCK", u64 sequence, u32 count, count * i32 keys, u32 checksum
+    int fd = ::open(ckptpath.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        std::vector<char> buf;
+        char chunk[1 << 16];
+        ssize_t n;
+        while ((n = ::read(fd, chunk, sizeof chunk)) > 0)
+            buf.insert(buf.end(), chunk, chunk + n);
+        ::close(fd);
+        if (n < 0)
+            fail("Cannot read " + ckptpath);
+        if (buf.size() < 20 || std::memcmp(buf.data(), "RBCK", 4) != 0)
+            throw std::runtime_error("Invalid checkpoint " + ckptpath);
+        std::uint32_t count = walGet<std::uint32_t>(buf.data() + 12);
+        if (buf.size() != 20 + 4 * size_t(count) ||
+            walGet<std::uint32_t>(buf.data() + 16 + 4*count) !=
+                walChecksum(buf.data(), 16 + 4*count))
+            throw std::runtime_error("Corrupted checkpoint " + ckptpath);
+        seq = walGet<std::uint64_t>(buf.data() + 4);
+        std::vector<int> keys(count);
+        std::memcpy(keys.data(), buf.data() + 16, 4 * size_t(count));
+        tree.buildSorted(keys);
+    } else if (errno != ENOENT) {
+        fail("Cannot open " + ckptpath);
+    }
+    recovered = replayLog();
+}
+
+long DurableRBST::replayLog() {
+    // Record : u64 sequence, i32 key, 1 byte op ('+' or '-'), 3 bytes of
+    // checksum over the first 13 bytes
+    int fd = ::open(logpath.c_str(), O_RDWR);
+    if (fd < 0) {
+        if (errno == ENOENT)
+            return 0;
+        fail("Cannot open " + logpath);
+    }
+    std::vector<char> buf(recordSize * 4096);
+    off_t valid = 0;    // Length of the log up to the last intact record
+    long count = 0;
+    size_t have = 0;
+    bool torn = false;
+    while (!torn) {
+        ssize_t n = ::read(fd, buf.data() + have, buf.size() - have);
+        if (n < 0) {
+            ::close(fd);
+            fail("Cannot read " + logpath);
+        }
+        have += n;
+        size_t i = 0;
+        for (; i + recordSize <= have; i += recordSize) {
+            const char* r = buf.data() + i;
+            std::uint32_t check = walChecksum(r, 13);
+            if (std::memcmp(r + 13, &check, 3) != 0 || (r[12] != '+' && r[12] != '-')) {
+                torn = true;
+                break;
+            }
+            valid += recordSize;
+            std::uint64_t s = walGet<std::uint64_t>(r);
+            if (s <= seq)
+                continue;   // Already contained in the checkpoint
+            int key = walGet<std::int32_t>(r + 8);
+            if (r[12] == '+') tree.insert(key);
+            else              tree.remove(key);
+            seq = s;
+            ++count;
+        }
+        if (n == 0) {
+            torn = torn || (i != have);     // Partial record at the end
+            break;
+        }
+        std::memmove(buf.data(), buf.data() + i, have - i);
+        have -= i;
+    }
+    if (torn && ::ftruncate(fd, valid) != 0) {
+        ::close(fd);
+        fail("Cannot truncate " + logpath);
+    }
+    ::close(fd);
+    sinceCkpt = count;
+    return count;
+}
+
+
+
+
+void DurableRBST::log(char op, int key) {
+    if (npending == 0)
+        oldest = Clock::now();
+    walPut<std::uint64_t>(pending, ++seq);
+    walPut<std::int32_t>(pending, key);
+    pending.push_back(op);
+    std::uint32_t check = walChecksum(pending.data() + pending.size() - 13, 13);
+    pending.insert(pending.end(), reinterpret_cast<char*>(&check),
+                   reinterpret_cast<char*>(&check) + 3);
+    ++npending;
+    ++sinceCkpt;
+
+    if (npending >= opt.groupSize || Clock::now() - oldest >= opt.groupDelay) {
+        try {
+            flush();
+        } catch (...) {
+            // The caller undoes this op, so its record must never be written.
+            // The earlier ones stay pending
+            pending.resize(pending.size() - recordSize);
+            --npending;
+            --sinceCkpt;
+            --seq;
+            throw;
+        }
+    }
+}
+
+void DurableRBST::checkpointIfDue() {
+    // Before an op changes the tree, so that the checkpoint only holds
+    // logged ops, and a failed one leaves nothing to undo
+    if (opt.checkpointEvery > 0 && sinceCkpt >= opt.checkpointEvery)
+        checkpoint();
+}
+
+void DurableRBST::flush() {
+    // One write & one fsync for the whole group of pending records
+    size_t done = 0;
+    while (done < pending.size()) {
+        ssize_t n = ::write(logfd, pending.data() + done, pending.size() - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            // Cut off the part of the group that was written, or retrying
+            // it would leave a torn record in the middle of the log (and
+            // recovery would drop everything after it). If even that fails,
+            // the log is closed, so nothing more is appended after the tear
+            int err = errno;
+            if (done > 0 && ::ftruncate(logfd, logSize) != 0) {
+                ::close(logfd);
+                logfd = -1;
+            }
+            errno = err;
+            fail("Cannot write " + logpath);
+        }
+        done += n;
+    }
+    logSize += done;
+    pending.clear();
+    npending = 0;
+    if (opt.fsync && ::fdatasync(logfd) != 0)
+        fail("Cannot sync " + logpath);
+}
+
+void DurableRBST::sync() {
+    if (npending > 0)
+        flush();
+}
+
+
+
+
+// Each op changes the tree first (which tells whether there's anything to
+// log), and undoes the change if logging it fails
+
+bool DurableRBST::insert(int x) {
+    checkpointIfDue();
+    if (!tree.insert(x))
+        return false;   // Duplicates don't change the tree, no need to log
+    try {
+        log('+', x);
+    } catch (...) {
+        tree.remove(x);
+        throw;
+    }
+    return true;
+}
+
+bool DurableRBST::remove(int x) {
+    checkpointIfDue();
+    if (!tree.remove(x))
+        return false;
+    try {
+        log('-', x);
+    } catch (...) {
+        tree.insert(x);
+        throw;
+    }
+    return true;
+}
+
+int DurableRBST::popMin() {
+    checkpointIfDue();
+    int x = tree.popMin();
+    try {
+        log('-', x);
+    } catch (...) {
+        tree.insert(x);
+        throw;
+    }
+    return x;
+}
+
+int DurableRBST::popMax() {
+    checkpointIfDue();
+    int x = tree.popMax();
+    try {
+        log('-', x);
+    } catch (...) {
+        tree.insert(x);
+        throw;
+    }
+    return x;
+}
+
+
+void DurableRBST::checkpoint() {
+    // Everything in the tree must be in the log first, so that the log
+    // can be truncated safely once the checkpoint is in place
+    sync();
+    std::vector<char> buf;
+    buf.reserve(20 + 4 * size_t(tree.size()));
+    buf.insert(buf.end(), {'R', 'B', 'C', 'K'});
+    walPut<std::uint64_t>(buf, seq);
+    walPut<std::uint32_t>(buf, tree.size());
+    RBST::InOrderTraverser en = tree.end();
+    for (RBST::InOrderTraverser it = tree.begin(); it != en; ++it)
+        walPut<std::int32_t>(buf, *it);
+    walPut<std::uint32_t>(buf, walChecksum(buf.data(), buf.size()));
+
+    // Written to a temporary file & renamed over the old one, so that
+    // there is always one complete checkpoint on disk
+    std::string tmp = ckptpath + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        fail("Cannot open " + tmp);
+    size_t done = 0;
+    while (done < buf.size()) {
+        ssize_t n = ::write(fd, buf.data() + done, buf.size() - done);
+        if (n < 0 && errno != EINTR) {
+            ::close(fd);
+            fail("Cannot write " + tmp);
+        }
+        done += (n > 0) ? n : 0;
+    }
+    bool synced = !opt.fsync || ::fsync(fd) == 0;
+    if (::close(fd) != 0 || !synced)
+        fail("Cannot sync " + tmp);
+    if (::rename(tmp.c_str(), ckptpath.c_str()) != 0)
+        fail("Cannot rename " + tmp);
+    if (opt.fsync) {
+        // Make the rename itself durable
+        int dfd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dfd >= 0) {
+            ::fsync(dfd);
+            ::close(dfd);
+        }
+    }
+    if (::ftruncate(logfd, 0) != 0)
+        fail("Cannot truncate " + logpath);
+    logSize = 0;
+    sinceCkpt = 0;
+}
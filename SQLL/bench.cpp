@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <forward_list>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <stack>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "sqll.hpp"
+#include "indexed.hpp"
+#include "blocks.hpp"
+#include "deque.hpp"
+
+/*
+Benchmarks of the SQLL containers, against the standard ones :
+- push + pop        : Stack, BlockStack, Deque (at the back), std::stack,
+                      std::forward_list
+- enqueue + dequeue : Queue, BlockQueue, Deque, std::queue
+- operator[], insert(i) + remove(i) at random positions :
+                      LinkedList, DoublyLinkedList, IndexedList,
+                      std::forward_list, std::deque
+- clear, print      : LinkedList, BlockQueue, std::forward_list, std::deque
+
+    ./bench [max size]
+
+Each case fills a container of the given size (untimed) and then times the
+operation, reporting ns & allocations (calls to operator new) per
+operation, and the peak resident memory of the whole case. Every case runs
+in a child process of its own, so that the peak RSS & the state of the
+pools belong to that case only.
+push/pop & enqueue/dequeue fill an empty container to the size and empty it
+again (repeatedly at small sizes), so 2 ops per element.
+Compile with -O2 -DNDEBUG.
+*/
+
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+
+// Every allocation in the program goes through here
+static long allocations = 0;
+
+void* operator new(size_t n) {
+    ++allocations;
+    if (void* p = malloc(n ? n : 1))
+        return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept {free(p);}
+void operator delete(void* p, size_t) noexcept {free(p);}
+
+
+// Runs setup(container) then times run(container) in a child process, and
+// prints a line of results. `ops` is the number of operations run() performs
+template <typename C, typename Setup, typename Run>
+void measure(const string& name, const string& op, int size, long ops,
+             Setup setup, Run run) {
+    cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid > 0) {
+        waitpid(pid, nullptr, 0);
+        return;
+    }
+    {
+        C c;
+        setup(c);
+        long a0 = allocations;
+        Clock::time_point t0 = Clock::now();
+        run(c);
+        double ns = chrono::duration<double, nano>(Clock::now() - t0).count();
+        long allocs = allocations - a0;
+        rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        cout << left << setw(20) << name << setw(18) << op << right
+             << setw(9) << size << fixed << setprecision(1)
+             << setw(12) << ns / ops << setw(12) << setprecision(3)
+             << double(allocs) / ops << setw(10) << setprecision(1)
+             << ru.ru_maxrss / 1024.0 << '\n';
+        cout.flush();
+    }
+    _exit(0);
+}
+
+
+template <typename C, typename Fill>
+void fillUp(C& c, int n, Fill fill) {
+    for (int i = 0; i < n; ++i)
+        fill(c, i);
+}
+
+vector<int> randomPositions(int size, long ops) {
+    mt19937 rng(size);
+    vector<int> pos(ops);
+    for (int& p : pos)
+        p = rng() % size;
+    return pos;
+}
+
+long sink = 0;
+
+
+
+/* push + pop, enqueue + dequeue */
+
+template <typename C, typename Push, typename Pop>
+void fillDrain(const string& name, const string& op, int n, Push push, Pop pop) {
+    int rounds = max(1, 1000000 / n);
+    measure<C>(name, op, n, 2L * n * rounds, [](C&) {},
+        [&](C& c) {
+            for (int r = 0; r < rounds; ++r) {
+                for (int i = 0; i < n; ++i)
+                    push(c, i);
+                for (int i = 0; i < n; ++i)
+                    sink += pop(c);
+            }
+        });
+}
+
+void stacks(int n) {
+    fillDrain<Stack<>>("Stack", "push+pop", n,
+        [](Stack<>& s, int x) {s.push(x);}, [](Stack<>& s) {return s.pop();});
+    fillDrain<BlockStack<>>("BlockStack", "push+pop", n,
+        [](BlockStack<>& s, int x) {s.push(x);}, [](BlockStack<>& s) {return s.pop();});
+    fillDrain<Deque<>>("Deque", "push+pop_back", n,
+        [](Deque<>& d, int x) {d.push_back(x);}, [](Deque<>& d) {return d.pop_back();});
+    fillDrain<stack<int>>("std::stack", "push+pop", n,
+        [](stack<int>& s, int x) {s.push(x);},
+        [](stack<int>& s) {int x = s.top(); s.pop(); return x;});
+    fillDrain<forward_list<int>>("std::forward_list", "push+pop", n,
+        [](forward_list<int>& s, int x) {s.push_front(x);},
+        [](forward_list<int>& s) {int x = s.front(); s.pop_front(); return x;});
+}
+
+void queues(int n) {
+    fillDrain<Queue<>>("Queue", "enqueue+dequeue", n,
+        [](Queue<>& q, int x) {q.enqueue(x);}, [](Queue<>& q) {return q.dequeue();});
+    fillDrain<BlockQueue<>>("BlockQueue", "enqueue+dequeue", n,
+        [](BlockQueue<>& q, int x) {q.enqueue(x);}, [](BlockQueue<>& q) {return q.dequeue();});
+    fillDrain<Deque<>>("Deque", "push+pop_front", n,
+        [](Deque<>& d, int x) {d.push_back(x);}, [](Deque<>& d) {return d.pop_front();});
+    fillDrain<queue<int>>("std::queue", "enqueue+dequeue", n,
+        [](queue<int>& q, int x) {q.push(x);},
+        [](queue<int>& q) {int x = q.front(); q.pop(); return x;});
+}
+
+
+
+/* Positional operations */
+
+// forward_list has no positions, so these walk from the front like LinkedList
+forward_list<int>::iterator before(forward_list<int>& f, int i) {
+    return next(f.before_begin(), i);
+}
+
+template <typename C, typename Fill, typename Index, typename Insert, typename Remove>
+void positional(const string& name, int n, Fill fill, Index index,
+                Insert insert, Remove remove) {
+    // Fewer ops at larger sizes, since the list walks are O(N) each
+    long ops = max(1000, min(1000000, 30000000 / n));
+    vector<int> pos = randomPositions(n, ops);
+    measure<C>(name, "operator[]", n, ops, [&](C& c) {fillUp(c, n, fill);},
+        [&](C& c) {
+            for (int p : pos)
+                sink += index(c, p);
+        });
+    measure<C>(name, "insert+remove", n, 2 * ops, [&](C& c) {fillUp(c, n, fill);},
+        [&](C& c) {
+            for (int p : pos) {
+                insert(c, p, p);
+                sink += remove(c, (p * 7) % (n + 1));
+            }
+        });
+}
+
+void positions(int n) {
+    positional<LinkedList<>>("LinkedList", n,
+        [](LinkedList<>& l, int x) {l.append(x);},
+        [](LinkedList<>& l, int i) {return int(l[i]);},
+        [](LinkedList<>& l, int i, int x) {l.insert(i, x);},
+        [](LinkedList<>& l, int i) {return l.remove(i);});
+    positional<DoublyLinkedList<>>("DoublyLinkedList", n,
+        [](DoublyLinkedList<>& l, int x) {l.append(x);},
+        [](DoublyLinkedList<>& l, int i) {return int(l[i]);},
+        [](DoublyLinkedList<>& l, int i, int x) {l.insert(i, x);},
+        [](DoublyLinkedList<>& l, int i) {return l.remove(i);});
+    positional<IndexedList<>>("IndexedList", n,
+        [](IndexedList<>& l, int x) {l.append(x);},
+        [](IndexedList<>& l, int i) {return int(l[i]);},
+        [](IndexedList<>& l, int i, int x) {l.insert(i, x);},
+        [](IndexedList<>& l, int i) {return l.remove(i);});
+    positional<forward_list<int>>("std::forward_list", n,
+        [](forward_list<int>& f, int x) {f.push_front(x);},
+        [](forward_list<int>& f, int i) {return *next(f.begin(), i);},
+        [](forward_list<int>& f, int i, int x) {f.insert_after(before(f, i), x);},
+        [](forward_list<int>& f, int i) {
+            auto b = before(f, i);
+            int x = *next(b);
+            f.erase_after(b);
+            return x;
+        });
+    positional<deque<int>>("std::deque", n,
+        [](deque<int>& d, int x) {d.push_back(x);},
+        [](deque<int>& d, int i) {return d[i];},
+        [](deque<int>& d, int i, int x) {d.insert(d.begin() + i, x);},
+        [](deque<int>& d, int i) {
+            int x = d[i];
+            d.erase(d.begin() + i);
+            return x;
+        });
+}
+
+
+
+/* clear & print, per element */
+
+template <typename C, typename Fill, typename Print>
+void clearPrint(const string& name, int n, Fill fill, Print print) {
+    measure<C>(name, "clear", n, n, [&](C& c) {fillUp(c, n, fill);},
+        [](C& c) {c.clear();});
+    measure<C>(name, "print", n, n, [&](C& c) {fillUp(c, n, fill);},
+        [&](C& c) {
+            ostringstream os;
+            print(c, os);
+            sink += os.str().size();
+        });
+}
+
+void clearsPrints(int n) {
+    clearPrint<LinkedList<>>("LinkedList", n,
+        [](LinkedList<>& l, int x) {l.append(x);},
+        [](LinkedList<>& l, ostream& os) {l.print(" ", "\n", os);});
+    clearPrint<BlockQueue<>>("BlockQueue", n,
+        [](BlockQueue<>& q, int x) {q.enqueue(x);},
+        [](BlockQueue<>& q, ostream& os) {q.print(" ", "\n", os);});
+    clearPrint<forward_list<int>>("std::forward_list", n,
+        [](forward_list<int>& f, int x) {f.push_front(x);},
+        [](forward_list<int>& f, ostream& os) {
+            for (int x : f) os << x << ' ';
+            os << '\n';
+        });
+    clearPrint<deque<int>>("std::deque", n,
+        [](deque<int>& d, int x) {d.push_back(x);},
+        [](deque<int>& d, ostream& os) {
+            for (int x : d) os << x << ' ';
+            os << '\n';
+        });
+}
+
+
+
+int main(int argc, char* argv[]) {
+    int maxn = (argc > 1) ? atoi(argv[1]) : 1000000;
+    cout << left << setw(20) << "container" << setw(18) << "operation" << right
+         << setw(9) << "size" << setw(12) << "ns/op" << setw(12) << "allocs/op"
+         << setw(10) << "peak MB" << '\n';
+    for (int n = 1000; n <= maxn; n *= 10) {
+        stacks(n);
+        queues(n);
+        cout << '\n';
+    }
+    // Positional operations on lists are O(N), so not at the largest size
+    for (int n = 1000; n <= maxn / 10; n *= 10) {
+        positions(n);
+        cout << '\n';
+    }
+    for (int n = 1000; n <= maxn; n *= 10) {
+        clearsPrints(n);
+        cout << '\n';
+    }
+    return (sink == 42);
+}
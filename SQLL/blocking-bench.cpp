@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "sqll.hpp"
+#include "blocking.hpp"
+
+/*
+BlockingQueue against a Queue behind a std::mutex whose consumers poll
+(yielding when it's empty), for several producer : consumer ratios.
+
+    ./blocking-bench [items]
+
+Every value is the time it was enqueued at, so consumers record the latency
+of each one. Two runs per case :
+- saturated : producers enqueue as fast as they can, giving the throughput
+  (and the latency is mostly time spent waiting in a full queue).
+- paced : producers sleep ~50us between values, so the queue is mostly
+  empty and consumers mostly wait, which is where wakeups matter.
+For each, the CPU time used per item and the context switches per 1000 items
+show the cost of waiting : polling burns CPU, signalling every value costs a
+switch per value, batched signals cost fewer but add upto `linger` latency.
+Compile with -O2 -DNDEBUG -pthread.
+*/
+
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+
+long long nowNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count();
+}
+
+struct Usage {
+    double cpu;     // user + system seconds
+    long switches;  // voluntary + involuntary
+
+    static Usage now() {
+        rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        return {ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+                (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6,
+                ru.ru_nvcsw + ru.ru_nivcsw};
+    }
+};
+
+
+void report(const string& name, int producers, int consumers, long items,
+            Clock::time_point t0, Usage u0, vector<vector<long long>>& lat) {
+    double s = chrono::duration<double>(Clock::now() - t0).count();
+    Usage u1 = Usage::now();
+    vector<long long> all;
+    for (vector<long long>& v : lat)
+        all.insert(all.end(), v.begin(), v.end());
+    auto pct = [&](double p) {
+        size_t k = min(all.size() - 1, size_t(p * all.size()));
+        nth_element(all.begin(), all.begin() + k, all.end());
+        return all[k] / 1000.0;
+    };
+    string ratio = to_string(producers) + ":" + to_string(consumers);
+    cout << left << setw(36) << name << setw(6) << ratio << right << fixed
+         << setprecision(2) << setw(10) << items / s / 1e6
+         << setprecision(1) << setw(10) << pct(0.5) << setw(10) << pct(0.99)
+         << setprecision(0) << setw(10) << (u1.cpu - u0.cpu) / items * 1e9
+         << setprecision(1) << setw(10) << (u1.switches - u0.switches) * 1000.0 / items;
+    if (long(all.size()) != items)
+        cout << "  LOST " << items - long(all.size());
+    cout << '\n';
+}
+
+
+// Producers each enqueue items/producers timestamps through enq(), consumers
+// call consume(record) until it returns false, record()ing every value
+template <typename Enq, typename Consume, typename Done>
+void run(const string& name, int producers, int consumers, long items, bool paced,
+         Enq enq, Consume consume, Done done) {
+    long per = items / producers;
+    vector<vector<long long>> lat(consumers);
+    for (vector<long long>& v : lat)
+        v.reserve(per * producers / consumers + 1024);
+    vector<thread> pool;
+    Usage u0 = Usage::now();
+    Clock::time_point t0 = Clock::now();
+    for (int c = 0; c < consumers; ++c) {
+        pool.emplace_back([&, c] {
+            vector<long long>& mine = lat[c];
+            auto record = [&](long long t) {mine.push_back(nowNs() - t);};
+            while (consume(record)) {}
+        });
+    }
+    vector<thread> prod;
+    for (int p = 0; p < producers; ++p) {
+        prod.emplace_back([&] {
+            for (long i = 0; i < per; ++i) {
+                enq(nowNs());
+                if (paced)
+                    this_thread::sleep_for(chrono::microseconds(50));
+            }
+        });
+    }
+    for (thread& t : prod)
+        t.join();
+    done();
+    for (thread& t : pool)
+        t.join();
+    report(name, producers, consumers, per * producers, t0, u0, lat);
+}
+
+
+void polling(int producers, int consumers, long items, bool paced) {
+    Queue<long long> q;
+    mutex m;
+    atomic<bool> finished(false);
+    run("Queue + mutex, polling", producers, consumers, items, paced,
+        [&](long long t) {lock_guard<mutex> g(m); q.enqueue(t);},
+        [&](auto record) {
+            {
+                lock_guard<mutex> g(m);
+                if (q.size() > 0) {
+                    record(q.dequeue());
+                    return true;
+                }
+            }
+            if (finished.load())
+                return false;
+            this_thread::yield();
+            return true;
+        },
+        [&] {finished.store(true);});
+}
+
+void blocking(size_t batch, bool many, int producers, int consumers, long items,
+              bool paced) {
+    BlockingQueue<long long> q(1024, batch);
+    string name = "BlockingQueue, batch " + to_string(batch) +
+                  (many ? ", dequeue_n" : "");
+    run(name, producers, consumers, items, paced,
+        [&](long long t) {q.enqueue(t);},
+        [&](auto record) {
+            if (many) {
+                long long buf[64];
+                size_t n = q.dequeue_n(buf, 64);
+                for (size_t i = 0; i < n; ++i)
+                    record(buf[i]);
+                return n > 0;
+            }
+            try {
+                record(q.dequeue());
+                return true;
+            } catch (const out_of_range&) {
+                return false;
+            }
+        },
+        [&] {q.close();});
+}
+
+
+void all(int producers, int consumers, long items, bool paced) {
+    polling(producers, consumers, items, paced);
+    blocking(1, false, producers, consumers, items, paced);
+    blocking(16, false, producers, consumers, items, paced);
+    blocking(16, true, producers, consumers, items, paced);
+}
+
+
+int main(int argc, char* argv[]) {
+    long items = (argc > 1) ? atol(argv[1]) : 1000000;
+    const int ratios[][2] = {{1, 1}, {1, 4}, {4, 1}, {4, 4}};
+    cout << left << setw(36) << "queue" << setw(6) << "P:C" << right
+         << setw(10) << "M/s" << setw(10) << "p50 us" << setw(10) << "p99 us"
+         << setw(10) << "cpu ns" << setw(10) << "csw/1k" << '\n';
+
+    cout << "Saturated, " << items << " items\n";
+    for (auto& r : ratios)
+        all(r[0], r[1], items, false);
+
+    // ~50us apart per producer, so far fewer items
+    long paced = max(1000L, items / 200);
+    cout << "\nPaced, " << paced << " items\n";
+    for (auto& r : ratios)
+        all(r[0], r[1], paced, true);
+    return 0;
+}
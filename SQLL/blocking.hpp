@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+
+
+/*
+Bounded blocking queue, for producer/consumer pipelines : instead of
+spinning on size() or catching the "Queue is empty" exception, consumers
+sleep until there is something to dequeue, and producers sleep while the
+queue is full (backpressure).
+
+- enqueue blocks while the queue is full, try_enqueue returns false instead.
+- dequeue blocks while it is empty, try_dequeue returns false instead, and
+  try_dequeue_for waits at most the given time. dequeue_n takes as many
+  values as are there (upto a maximum) at once, waiting only for the first.
+- close() ends the stream : enqueueing afterwards throws std::logic_error,
+  and once the remaining values are gone, dequeue throws std::out_of_range
+  ("Queue is closed") while the others return false / 0, instead of waiting.
+
+Wakeups are batched : waking a sleeping thread costs a few microseconds, so
+producers only signal the consumers after `batch` values have been enqueued
+since the last signal (and a woken consumer passes the signal on if at least
+that many are still left). Consumers of an empty queue sleep without a
+timeout. The first value of a batch wakes one of them, which then lingers
+until the batch is complete or `linger` has passed since that value, and
+takes what's there; so the latency batching adds is at most `linger`. In the
+same way, consumers only wake sleeping producers once there's room for
+`batch` values. With batch = 1, every operation signals (the usual
+behaviour). batch is capped at the capacity, since a full queue can't hold
+more than that.
+
+The values are in a ring buffer, so T must be default constructible & move
+assignable. Every thread may enqueue & dequeue. There is no front()/back(),
+since they may change as soon as they return.
+*/
+template <typename T = int>
+class BlockingQueue {
+
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<T> buf;
+    std::size_t head = 0;
+    std::size_t count = 0;
+    bool closed = false;
+
+    const std::size_t batch;
+    const std::chrono::microseconds linger;
+    std::size_t unsignalled = 0;
+    Clock::time_point firstUnsignalled;
+    int sleepingConsumers = 0;
+    int lingeringConsumers = 0;     // Those waiting for a batch to complete
+    int sleepingProducers = 0;
+
+    mutable std::mutex m;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+
+    template <typename U>
+    bool push(U&&, bool wait);
+    bool waitNotEmpty(std::unique_lock<std::mutex>&, Clock::time_point);
+    T take();
+    void signalAfterTake(std::unique_lock<std::mutex>&);
+
+    public :
+        BlockingQueue(std::size_t capacity = 1024, std::size_t batch = 16,
+                      std::chrono::microseconds linger = std::chrono::microseconds(200));
+        BlockingQueue(const BlockingQueue&) = delete;
+        BlockingQueue& operator=(const BlockingQueue&) = delete;
+
+        void enqueue(const T& val) {push(val, true);}
+        void enqueue(T&& val) {push(std::move(val), true);}
+        bool try_enqueue(const T& val) {return push(val, false);}
+        bool try_enqueue(T&& val) {return push(std::move(val), false);}
+
+        T dequeue();
+        bool try_dequeue(T&);
+        template <typename Rep, typename Period>
+        bool try_dequeue_for(T&, std::chrono::duration<Rep, Period>);
+        std::size_t dequeue_n(T*, std::size_t);
+
+        void close();
+        int size() const;
+        std::size_t capacity() const {return buf.size();}
+};
+
+
+template <typename T>
+BlockingQueue<T>::BlockingQueue(std::size_t capacity, std::size_t batch,
+                                std::chrono::microseconds linger)
+    : buf(capacity), batch(std::max<std::size_t>(1, std::min(batch, capacity))),
+      linger(linger) {
+    if (capacity == 0)
+        throw std::invalid_argument("BlockingQueue capacity must be positive");
+}
+
+
+template <typename T>
+template <typename U>
+bool BlockingQueue<T>::push(U&& val, bool wait) {
+    std::unique_lock<std::mutex> lock(m);
+    while (count == buf.size() && !closed) {
+        if (!wait)
+            return false;
+        // The timeout only matters if a consumer left before enough room
+        // was made to signal
+        ++sleepingProducers;
+        notFull.wait_for(lock, linger);
+        --sleepingProducers;
+    }
+    if (closed) {
+        if (!wait)
+            return false;
+        throw std::logic_error("Enqueueing to a closed queue");
+    }
+    buf[(head + count) % buf.size()] = std::forward<U>(val);
+    ++count;
+    bool signal = false;
+    if (sleepingConsumers > 0) {
+        if (++unsignalled >= batch) {
+            unsignalled = 0;
+            signal = true;
+        } else if (unsignalled == 1) {
+            // Starts the linger time. The sleepers have no timeout, so one
+            // is woken to wait for the rest of the batch, unless one is already
+            firstUnsignalled = Clock::now();
+            signal = (lingeringConsumers == 0);
+        }
+    }
+    lock.unlock();
+    if (signal)
+        notEmpty.notify_one();
+    return true;
+}
+
+
+template <typename T>
+bool BlockingQueue<T>::waitNotEmpty(std::unique_lock<std::mutex>& lock,
+                                    Clock::time_point deadline) {
+    // Sleeps until there's a value, the queue is closed or the deadline
+    // passes. True if there's a value. Once asleep, values below the batch
+    // threshold are only taken when their linger time is up
+    bool slept = false;
+    while (!closed) {
+        Clock::time_point now = Clock::now();
+        if (count > 0 && (!slept || unsignalled == 0 || count >= batch ||
+                          now >= firstUnsignalled + linger))
+            return true;
+        if (now >= deadline)
+            return count > 0;
+        ++sleepingConsumers;
+        if (count > 0) {
+            ++lingeringConsumers;
+            notEmpty.wait_until(lock, std::min(deadline, firstUnsignalled + linger));
+            --lingeringConsumers;
+        } else if (deadline == Clock::time_point::max()) {
+            notEmpty.wait(lock);
+        } else {
+            notEmpty.wait_until(lock, deadline);
+        }
+        --sleepingConsumers;
+        slept = true;
+    }
+    return count > 0;
+}
+
+template <typename T>
+T BlockingQueue<T>::take() {
+    T val = std::move(buf[head]);
+    head = (head + 1) % buf.size();
+    --count;
+    return val;
+}
+
+template <typename T>
+void BlockingQueue<T>::signalAfterTake(std::unique_lock<std::mutex>& lock) {
+    // Passes the signal on to another consumer if a batch is still left, and
+    // wakes the producers once there's room for a batch. Unlocks
+    bool consumer = sleepingConsumers > 0 && count >= batch;
+    bool producers = sleepingProducers > 0 && buf.size() - count >= batch;
+    if (count == 0)
+        unsignalled = 0;
+    lock.unlock();
+    if (consumer)
+        notEmpty.notify_one();
+    if (producers)
+        notFull.notify_all();
+}
+
+
+template <typename T>
+T BlockingQueue<T>::dequeue() {
+    std::unique_lock<std::mutex> lock(m);
+    if (!waitNotEmpty(lock, Clock::time_point::max()))
+        throw std::out_of_range("Queue is closed");
+    T val = take();
+    signalAfterTake(lock);
+    return val;
+}
+
+template <typename T>
+bool BlockingQueue<T>::try_dequeue(T& val) {
+    std::unique_lock<std::mutex> lock(m);
+    if (count == 0)
+        return false;
+    val = take();
+    signalAfterTake(lock);
+    return true;
+}
+
+template <typename T>
+template <typename Rep, typename Period>
+bool BlockingQueue<T>::try_dequeue_for(T& val, std::chrono::duration<Rep, Period> timeout) {
+    std::unique_lock<std::mutex> lock(m);
+    Clock::time_point deadline = Clock::now() +
+        std::chrono::duration_cast<Clock::duration>(timeout);
+    if (!waitNotEmpty(lock, deadline))
+        return false;
+    val = take();
+    signalAfterTake(lock);
+    return true;
+}
+
+template <typename T>
+std::size_t BlockingQueue<T>::dequeue_n(T* vals, std::size_t n) {
+    // Waits for at least one value (unless closed), then takes upto n
+    std::unique_lock<std::mutex> lock(m);
+    if (n == 0 || !waitNotEmpty(lock, Clock::time_point::max()))
+        return 0;
+    std::size_t k = std::min(n, count);
+    for (std::size_t i = 0; i < k; ++i)
+        vals[i] = take();
+    signalAfterTake(lock);
+    return k;
+}
+
+
+template <typename T>
+void BlockingQueue<T>::close() {
+    {
+        std::lock_guard<std::mutex> lock(m);
+        closed = true;
+    }
+    notEmpty.notify_all();
+    notFull.notify_all();
+}
+
+template <typename T>
+int BlockingQueue<T>::size() const {
+    std::lock_guard<std::mutex> lock(m);
+    return int(count);
+}
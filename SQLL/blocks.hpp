@@ -0,0 +1,359 @@
+#pragma once
+
+#include <initializer_list>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+
+
+/*
+Stack and Queue with the values stored in fixed size contiguous blocks
+rather than one node each, like a std::deque.
+
+Each block holds `perBlock` values (512 bytes worth, or 1 value if T is
+bigger than that), and the blocks are doubly linked in order. The values
+are the ones from index `head` in the first block upto (but not including)
+index `tail` in the last block. So :
+- An int takes 4 bytes plus a share of the block's two pointers, instead of
+  a 16 byte node (which itself needs a pool or an allocation).
+- Pushing & popping at either end is O(1), and only allocates / frees when
+  crossing a block boundary. A freed block is kept as a spare for the next
+  one needed, so a stack going up & down around a boundary, or a queue in a
+  steady state (the drained head block becomes the next tail block), doesn't
+  allocate at all.
+- print() & clear() are sequential scans through whole blocks.
+
+BlockStack & BlockQueue have the same interface as Stack & Queue, except
+that push/enqueue/top/front/back return a reference to the value itself
+(there is no node to traverse from).
+*/
+template <typename T>
+class BlockList {
+
+    protected :
+        static const int perBlock = (sizeof(T) < 512) ? int(512 / sizeof(T)) : 1;
+
+        struct Block {
+            Block* prev;
+            Block* next;
+            alignas(T) unsigned char raw[perBlock * sizeof(T)];
+            T* at(int i) {return reinterpret_cast<T*>(raw) + i;}
+        };
+
+        Block* first = nullptr;
+        Block* last = nullptr;
+        int head = 0;
+        int tail = 0;
+        int l = 0;
+        Block* spare = nullptr;
+
+        Block* newBlock();
+        void freeBlock(Block*);
+
+        template <typename... Args>
+        T& emplaceBack(Args&&...);
+        T popBack();
+        T popFront();
+        void printReverse(const std::string&, const std::string&, std::ostream&);
+
+    public :
+        BlockList() = default;
+        BlockList(const std::initializer_list<T>&);
+        BlockList(const BlockList&);
+        BlockList(BlockList&&) noexcept;
+        BlockList& operator=(const BlockList&);
+        BlockList& operator=(BlockList&&) noexcept;
+        ~BlockList() {clear(); delete spare;}
+
+        int size() {return l;}
+        void clear();
+        void print(const std::string& = " ", const std::string& = "\n",
+                   std::ostream& = std::cout);
+};
+
+
+template <typename T>
+typename BlockList<T>::Block* BlockList<T>::newBlock() {
+    Block* b = spare;
+    if (b != nullptr)
+        spare = nullptr;
+    else
+        b = new Block;
+    b->prev = b->next = nullptr;
+    return b;
+}
+
+template <typename T>
+void BlockList<T>::freeBlock(Block* b) {
+    // Kept for reuse if there's no spare yet
+    if (spare == nullptr)
+        spare = b;
+    else
+        delete b;
+}
+
+
+template <typename T>
+BlockList<T>::BlockList(const std::initializer_list<T>& il) {
+    for (const T& x : il)
+        emplaceBack(x);
+}
+
+template <typename T>
+BlockList<T>::BlockList(const BlockList& o) {
+    Block* b = o.first;
+    for (int i = o.head, n = 0; n < o.l; ++n) {
+        emplaceBack(*b->at(i));
+        if (++i == perBlock) {
+            b = b->next;
+            i = 0;
+        }
+    }
+}
+
+template <typename T>
+BlockList<T>::BlockList(BlockList&& o) noexcept
+    : first(o.first), last(o.last), head(o.head), tail(o.tail), l(o.l) {
+    o.first = o.last = nullptr;
+    o.head = o.tail = o.l = 0;
+}
+
+template <typename T>
+BlockList<T>& BlockList<T>::operator=(const BlockList& o) {
+    if (this != &o) {
+        BlockList copy(o);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+template <typename T>
+BlockList<T>& BlockList<T>::operator=(BlockList&& o) noexcept {
+    if (this != &o) {
+        clear();
+        std::swap(first, o.first);
+        std::swap(last, o.last);
+        std::swap(head, o.head);
+        std::swap(tail, o.tail);
+        std::swap(l, o.l);
+    }
+    return *this;
+}
+
+
+template <typename T>
+template <typename... Args>
+T& BlockList<T>::emplaceBack(Args&&... args) {
+    if (last != nullptr && tail < perBlock) {
+        T* p = new (last->at(tail)) T(std::forward<Args>(args)...);
+        ++tail;
+        ++l;
+        return *p;
+    }
+    // Last block full (or none) : the value goes first in a new block
+    Block* b = newBlock();
+    T* p;
+    try {
+        p = new (b->at(0)) T(std::forward<Args>(args)...);
+    } catch (...) {
+        freeBlock(b);
+        throw;
+    }
+    b->prev = last;
+    if (last != nullptr) {
+        last->next = b;
+    } else {
+        first = b;
+        head = 0;
+    }
+    last = b;
+    tail = 1;
+    ++l;
+    return *p;
+}
+
+template <typename T>
+T BlockList<T>::popBack() {
+    T* p = last->at(tail - 1);
+    T val = std::move(*p);
+    p->~T();
+    --tail;
+    --l;
+    if (l == 0) {
+        freeBlock(last);
+        first = last = nullptr;
+        head = tail = 0;
+    } else if (tail == 0) {
+        Block* b = last;
+        last = b->prev;
+        last->next = nullptr;
+        tail = perBlock;
+        freeBlock(b);
+    }
+    return val;
+}
+
+template <typename T>
+T BlockList<T>::popFront() {
+    T* p = first->at(head);
+    T val = std::move(*p);
+    p->~T();
+    ++head;
+    --l;
+    if (l == 0) {
+        freeBlock(first);
+        first = last = nullptr;
+        head = tail = 0;
+    } else if (head == perBlock) {
+        Block* b = first;
+        first = b->next;
+        first->prev = nullptr;
+        head = 0;
+        freeBlock(b);
+    }
+    return val;
+}
+
+
+template <typename T>
+void BlockList<T>::clear() {
+    Block* b = first;
+    while (b != nullptr) {
+        if (!std::is_trivially_destructible<T>::value) {
+            int from = (b == first) ? head : 0;
+            int to = (b == last) ? tail : perBlock;
+            for (int i = from; i < to; ++i)
+                b->at(i)->~T();
+        }
+        Block* nx = b->next;
+        freeBlock(b);
+        b = nx;
+    }
+    first = last = nullptr;
+    head = tail = l = 0;
+}
+
+template <typename T>
+void BlockList<T>::print(const std::string& sep, const std::string& fin,
+                         std::ostream& stream) {
+    for (Block* b = first; b != nullptr; b = b->next) {
+        int from = (b == first) ? head : 0;
+        int to = (b == last) ? tail : perBlock;
+        for (int i = from; i < to; ++i) {
+            stream << *b->at(i);
+            if (b != last || i != tail - 1)
+                stream << sep;
+        }
+    }
+    stream << fin;
+}
+
+template <typename T>
+void BlockList<T>::printReverse(const std::string& sep, const std::string& fin,
+                                std::ostream& stream) {
+    for (Block* b = last; b != nullptr; b = b->prev) {
+        int from = (b == first) ? head : 0;
+        int to = (b == last) ? tail : perBlock;
+        for (int i = to - 1; i >= from; --i) {
+            stream << *b->at(i);
+            if (b != first || i != head)
+                stream << sep;
+        }
+    }
+    stream << fin;
+}
+
+
+
+template <typename T = int>
+class BlockStack : private BlockList<T> {
+
+    using Base = BlockList<T>;
+
+    public :
+        using Base::Base;
+        using Base::size;
+        using Base::clear;
+
+        BlockStack() = default;
+        // The first value is the top one, like Stack
+        BlockStack(const std::initializer_list<T>& il) {
+            for (const T* p = il.end(); p != il.begin(); )
+                this->emplaceBack(*--p);
+        }
+
+        // Top first, like Stack
+        void print(const std::string& sep = " ", const std::string& fin = "\n",
+                   std::ostream& stream = std::cout) {
+            this->printReverse(sep, fin, stream);
+        }
+        T& push(const T& val) {
+            return this->emplaceBack(val);
+        }
+        T& push(T&& val) {
+            return this->emplaceBack(std::move(val));
+        }
+        template <typename... Args>
+        T& emplace(Args&&... args) {
+            return this->emplaceBack(std::forward<Args>(args)...);
+        }
+        T pop() {
+            if (this->l>0)
+                return this->popBack();
+            else
+                throw std::out_of_range("Stack is empty");
+        }
+        T& top() {
+            if (this->l>0)
+                return *this->last->at(this->tail - 1);
+            else
+                throw std::out_of_range("Stack is empty");
+        }
+};
+
+
+
+template <typename T = int>
+class BlockQueue : private BlockList<T> {
+
+    using Base = BlockList<T>;
+
+    public :
+        using Base::Base;
+        using Base::size;
+        using Base::print;
+        using Base::clear;
+
+        T& enqueue(const T& val) {
+            return this->emplaceBack(val);
+        }
+        T& enqueue(T&& val) {
+            return this->emplaceBack(std::move(val));
+        }
+        template <typename... Args>
+        T& emplace(Args&&... args) {
+            return this->emplaceBack(std::forward<Args>(args)...);
+        }
+        T dequeue() {
+            if (this->l>0)
+                return this->popFront();
+            else
+                throw std::out_of_range("Queue is empty");
+        }
+        T& front() {
+            if (this->l>0)
+                return *this->first->at(this->head);
+            else
+                throw std::out_of_range("Queue is empty");
+        }
+        T& back() {
+            if (this->l>0)
+                return *this->last->at(this->tail - 1);
+            else
+                throw std::out_of_range("Queue is empty");
+        }
+};
@@ -0,0 +1,197 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sqll.hpp"
+#include "concurrent.hpp"
+
+/*
+Throughput of the concurrent containers in concurrent.hpp, against the
+plain containers of sqll.hpp behind a std::mutex.
+
+    ./concurrent-bench [items]
+
+Waiting threads yield instead of spinning, so that results are still
+meaningful with fewer cores than threads (but lock-free containers only
+show their advantage with a core per thread).
+Compile with -O2 -DNDEBUG -pthread.
+*/
+
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+
+void report(const string& name, long items, Clock::time_point t0) {
+    double s = chrono::duration<double>(Clock::now() - t0).count();
+    cout << left << setw(40) << name << right << fixed << setprecision(2)
+         << setw(10) << items / s / 1e6 << " M items/s\n";
+}
+
+
+
+/* SPSC : one thread hands `items` ints to another */
+
+void spscLocked(long items) {
+    Queue<> q;
+    mutex m;
+    long sum = 0;
+    Clock::time_point t0 = Clock::now();
+    thread consumer([&] {
+        for (long got = 0; got < items; ) {
+            {
+                lock_guard<mutex> lock(m);
+                while (q.size() > 0) {
+                    sum += q.dequeue();
+                    ++got;
+                }
+            }
+            this_thread::yield();
+        }
+    });
+    for (long i = 0; i < items; ++i) {
+        lock_guard<mutex> lock(m);
+        q.enqueue(int(i));
+    }
+    consumer.join();
+    report("Queue + mutex", items, t0);
+    if (sum != items * (items - 1) / 2) cout << "  WRONG SUM\n";
+}
+
+void spscRing(long items, size_t batch) {
+    SPSCQueue<int> q(4096);
+    long sum = 0;
+    Clock::time_point t0 = Clock::now();
+    thread consumer([&] {
+        vector<int> buf(batch);
+        for (long got = 0; got < items; ) {
+            if (batch == 1) {
+                int v;
+                if (q.try_dequeue(v)) {sum += v; ++got;}
+                else this_thread::yield();
+            } else {
+                size_t n = q.dequeue_n(buf.data(), batch);
+                for (size_t i = 0; i < n; ++i) sum += buf[i];
+                got += n;
+                if (n == 0) this_thread::yield();
+            }
+        }
+    });
+    if (batch == 1) {
+        for (long i = 0; i < items; ++i)
+            while (!q.try_enqueue(int(i))) this_thread::yield();
+    } else {
+        vector<int> buf(batch);
+        for (long i = 0; i < items; ) {
+            size_t n = min<long>(batch, items - i);
+            for (size_t j = 0; j < n; ++j) buf[j] = int(i + j);
+            for (size_t done = 0; done < n; ) {
+                size_t k = q.enqueue_n(buf.data() + done, n - done);
+                if (k == 0) this_thread::yield();
+                done += k;
+            }
+            i += n;
+        }
+    }
+    consumer.join();
+    report("SPSCQueue" + ((batch > 1) ? ", batches of " + to_string(batch) : ""),
+           items, t0);
+    if (sum != items * (items - 1) / 2) cout << "  WRONG SUM\n";
+}
+
+
+
+/* MPMC : every thread alternately inserts & removes, sharing one container */
+
+template <typename Q, typename Enq, typename Deq>
+void mpmc(const string& name, int threads, long items, Enq enq, Deq deq) {
+    Q q;
+    long per = items / threads;
+    vector<long> sums(threads, 0);
+    vector<thread> pool;
+    Clock::time_point t0 = Clock::now();
+    for (int k = 0; k < threads; ++k) {
+        pool.emplace_back([&, k] {
+            long sum = 0;
+            for (long i = 0; i < per; ++i) {
+                enq(q, int(i));
+                int v;
+                while (!deq(q, v)) this_thread::yield();
+                sum += v;
+            }
+            sums[k] = sum;
+        });
+    }
+    for (thread& t : pool)
+        t.join();
+    report(name + ", " + to_string(threads) + " threads", per * threads, t0);
+    long total = 0;
+    for (long s : sums) total += s;
+    if (total != threads * (per * (per - 1) / 2)) cout << "  WRONG SUM\n";
+}
+
+struct LockedQueue {
+    Queue<> q;
+    mutex m;
+};
+
+void mpmcAll(long items, int maxthreads) {
+    for (int t = 1; t <= maxthreads; t *= 2) {
+        mpmc<LockedQueue>("Queue + mutex", t, items,
+            [](LockedQueue& l, int v) {lock_guard<mutex> g(l.m); l.q.enqueue(v);},
+            [](LockedQueue& l, int& v) {
+                lock_guard<mutex> g(l.m);
+                if (l.q.size() == 0) return false;
+                v = l.q.dequeue();
+                return true;
+            });
+        mpmc<ConcurrentQueue<>>("ConcurrentQueue", t, items,
+            [](ConcurrentQueue<>& q, int v) {q.enqueue(v);},
+            [](ConcurrentQueue<>& q, int& v) {return q.try_dequeue(v);});
+    }
+}
+
+
+struct LockedStack {
+    Stack<> s;
+    mutex m;
+};
+
+void stackAll(long items, int maxthreads) {
+    for (int t = 1; t <= maxthreads; t *= 2) {
+        mpmc<LockedStack>("Stack + mutex", t, items,
+            [](LockedStack& l, int v) {lock_guard<mutex> g(l.m); l.s.push(v);},
+            [](LockedStack& l, int& v) {
+                lock_guard<mutex> g(l.m);
+                if (l.s.size() == 0) return false;
+                v = l.s.pop();
+                return true;
+            });
+        mpmc<ConcurrentStack<>>("ConcurrentStack", t, items,
+            [](ConcurrentStack<>& s, int v) {s.push(v);},
+            [](ConcurrentStack<>& s, int& v) {return s.try_pop(v);});
+    }
+}
+
+
+
+int main(int argc, char* argv[]) {
+    long items = (argc > 1) ? atol(argv[1]) : 10000000;
+    int maxthreads = max(4u, thread::hardware_concurrency());
+    cout << "1 producer -> 1 consumer, " << items << " ints\n";
+    spscLocked(items);
+    spscRing(items, 1);
+    spscRing(items, 64);
+
+    cout << "\nEnqueue + dequeue pairs, " << items / 4 << " per run\n";
+    mpmcAll(items / 4, maxthreads);
+
+    cout << "\nPush + pop pairs, " << items / 4 << " per run\n";
+    stackAll(items / 4, maxthreads);
+    return 0;
+}
@@ -0,0 +1,659 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+
+/*
+Containers that can be shared between threads without a lock, as
+alternatives to wrapping a Stack/Queue (see sqll.hpp) in a mutex.
+*/
+
+// Size of a cache line. Data written by different threads is kept this far
+// apart, so that their writes don't keep invalidating each other's caches
+const std::size_t cacheLine = 64;
+
+
+
+
+/*
+Bounded single producer / single consumer queue, on a ring buffer.
+Exactly one thread may enqueue and exactly one (other) thread may dequeue
+at a time; nothing is allocated after construction.
+
+- The producer only writes `tail` and the consumer only writes `head`, so
+  each index needs just a release store by its owner & an acquire load by
+  the other thread, which publishes the elements written in between.
+- Each side also keeps a cached copy of the other side's index, and only
+  reloads it when the queue looks full (or empty). Most operations then
+  touch no cache line written by the other thread, except the element.
+- The indices count up forever & are reduced modulo the capacity (a power
+  of two) to get a slot, so that full & empty are distinguishable.
+
+Same interface as Queue, except that values are returned rather than nodes,
+and that enqueue throws std::out_of_range when the queue is full (like
+dequeue when it's empty). The try_ versions return false instead, and the
+_n versions move as many elements as possible with one index update.
+Elements are moved in & out of their slots, so T must be default
+constructible & move assignable.
+front() may only be called by the consumer, & back() by the producer; both
+return a copy. (For a T that isn't trivially copyable, back() also races
+with the consumer dequeuing that same element.)
+size() is exact only when called by one of the two (with no concurrent
+operation by the other), and approximate otherwise.
+*/
+template <typename T = int>
+class SPSCQueue {
+
+    T* buf;
+    std::size_t mask;
+
+    // Written by the consumer
+    alignas(cacheLine) std::atomic<std::size_t> head {0};
+    std::size_t tailCache = 0;
+    // Written by the producer
+    alignas(cacheLine) std::atomic<std::size_t> tail {0};
+    std::size_t headCache = 0;
+
+    template <typename U>
+    bool tryPush(U&&);
+    template <typename U>
+    void push(U&&);
+
+    public :
+        // Capacity is rounded up to a power of two
+        SPSCQueue(std::size_t capacity = 1024);
+        ~SPSCQueue() {delete[] buf;}
+        SPSCQueue(const SPSCQueue&) = delete;
+        SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+        bool try_enqueue(const T& val) {return tryPush(val);}
+        bool try_enqueue(T&& val) {return tryPush(std::move(val));}
+        void enqueue(const T& val) {push(val);}
+        void enqueue(T&& val) {push(std::move(val));}
+        template <typename... Args>
+        void emplace(Args&&... args) {push(T(std::forward<Args>(args)...));}
+        std::size_t enqueue_n(const T*, std::size_t);
+        bool try_dequeue(T&);
+        T dequeue();
+        std::size_t dequeue_n(T*, std::size_t);
+
+        T front();
+        T back();
+        int size() const;
+        std::size_t capacity() const {return mask + 1;}
+};
+
+template <typename T>
+SPSCQueue<T>::SPSCQueue(std::size_t capacity) {
+    std::size_t c = 1;
+    while (c < capacity)
+        c <<= 1;
+    buf = new T[c];
+    mask = c - 1;
+}
+
+
+template <typename T>
+template <typename U>
+bool SPSCQueue<T>::tryPush(U&& val) {
+    std::size_t t = tail.load(std::memory_order_relaxed);
+    if (t - headCache > mask) {
+        headCache = head.load(std::memory_order_acquire);
+        if (t - headCache > mask)
+            return false;   // Full
+    }
+    buf[t & mask] = std::forward<U>(val);
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+template <typename U>
+void SPSCQueue<T>::push(U&& val) {
+    if (!tryPush(std::forward<U>(val)))
+        throw std::out_of_range("Queue is full");
+}
+
+template <typename T>
+std::size_t SPSCQueue<T>::enqueue_n(const T* vals, std::size_t n) {
+    // Enqueues the first (upto) n values, returns how many fit
+    std::size_t t = tail.load(std::memory_order_relaxed);
+    if (t - headCache + n > mask + 1)
+        headCache = head.load(std::memory_order_acquire);
+    std::size_t room = mask + 1 - (t - headCache);
+    if (n > room)
+        n = room;
+    for (std::size_t i = 0; i < n; ++i)
+        buf[(t + i) & mask] = vals[i];
+    tail.store(t + n, std::memory_order_release);
+    return n;
+}
+
+
+template <typename T>
+bool SPSCQueue<T>::try_dequeue(T& val) {
+    std::size_t h = head.load(std::memory_order_relaxed);
+    if (h == tailCache) {
+        tailCache = tail.load(std::memory_order_acquire);
+        if (h == tailCache)
+            return false;   // Empty
+    }
+    val = std::move(buf[h & mask]);
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+T SPSCQueue<T>::dequeue() {
+    T val;
+    if (!try_dequeue(val))
+        throw std::out_of_range("Queue is empty");
+    return val;
+}
+
+template <typename T>
+std::size_t SPSCQueue<T>::dequeue_n(T* vals, std::size_t n) {
+    // Dequeues upto n values into `vals`, returns how many there were
+    std::size_t h = head.load(std::memory_order_relaxed);
+    if (tailCache - h < n)
+        tailCache = tail.load(std::memory_order_acquire);
+    if (n > tailCache - h)
+        n = tailCache - h;
+    for (std::size_t i = 0; i < n; ++i)
+        vals[i] = std::move(buf[(h + i) & mask]);
+    head.store(h + n, std::memory_order_release);
+    return n;
+}
+
+
+template <typename T>
+T SPSCQueue<T>::front() {
+    std::size_t h = head.load(std::memory_order_relaxed);
+    if (h == tailCache)
+        tailCache = tail.load(std::memory_order_acquire);
+    if (h == tailCache)
+        throw std::out_of_range("Queue is empty");
+    return buf[h & mask];
+}
+
+template <typename T>
+T SPSCQueue<T>::back() {
+    std::size_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire))
+        throw std::out_of_range("Queue is empty");
+    return buf[(t - 1) & mask];
+}
+
+template <typename T>
+int SPSCQueue<T>::size() const {
+    std::size_t h = head.load(std::memory_order_acquire);
+    std::size_t t = tail.load(std::memory_order_acquire);
+    return (t > h) ? int(t - h) : 0;
+}
+
+
+
+
+/*
+Hazard pointers, for safe memory reclamation in lock-free containers.
+
+A node unlinked from a lock-free structure can't be deleted immediately,
+since other threads may have read a pointer to it just before, and still be
+about to dereference it. So before dereferencing a shared pointer, a thread
+publishes it in one of its hazard pointer slots (protect), and clears the
+slot when done. Unlinked nodes are retired instead of deleted; every so
+often a thread scans all published hazard pointers, and deletes only those
+of its retired nodes that no thread has published.
+
+This also prevents the ABA problem for CAS on protected pointers : a node
+can't be freed & reallocated at the same address while a thread that may
+still compare against its address has it protected.
+
+Each thread claims one record of `perThread` slots on first use (upto
+`maxThreads` threads at once), and releases it when it exits. Nodes still
+protected by others at that point are handed over to the next thread that
+scans.
+*/
+class HazardPointers {
+
+    public :
+        static const int perThread = 2;
+        static const int maxThreads = 128;
+
+        // Publishes the pointer currently in `src` in slot i, and returns it
+        template <typename T>
+        static T* protect(int i, const std::atomic<T*>& src);
+        static void clear(int i) {
+            local().rec->hp[i].store(nullptr, std::memory_order_release);
+        }
+        template <typename T>
+        static void retire(T* p) {
+            retire(p, [](void* q) {delete static_cast<T*>(q);});
+        }
+        static void retire(void*, void (*)(void*));
+
+    private :
+        struct alignas(cacheLine) Record {
+            std::atomic<bool> active {false};
+            std::atomic<void*> hp[perThread] {};
+        };
+        struct Retired {
+            void* p;
+            void (*deleter)(void*);
+        };
+        struct Local {
+            Record* rec;
+            std::vector<Retired> retired;
+            Local();
+            ~Local();
+        };
+
+        static const std::size_t scanThreshold = 2 * perThread * maxThreads;
+        static Record records[maxThreads];
+        // Retired nodes left behind by threads that have exited
+        static std::mutex orphanLock;
+        static std::vector<Retired> orphans;
+        static std::atomic<bool> haveOrphans;
+
+        static Local& local() {thread_local Local l; return l;}
+        static void scan(Local&);
+};
+
+inline HazardPointers::Record HazardPointers::records[maxThreads];
+inline std::mutex HazardPointers::orphanLock;
+inline std::vector<HazardPointers::Retired> HazardPointers::orphans;
+inline std::atomic<bool> HazardPointers::haveOrphans {false};
+
+
+template <typename T>
+T* HazardPointers::protect(int i, const std::atomic<T*>& src) {
+    std::atomic<void*>& slot = local().rec->hp[i];
+    T* p = src.load(std::memory_order_relaxed);
+    while (true) {
+        slot.store(p, std::memory_order_seq_cst);
+        // If src still holds p after publishing it, then p wasn't retired
+        // before any scan could see it (retiring comes after unlinking)
+        T* q = src.load(std::memory_order_seq_cst);
+        if (q == p)
+            return p;
+        p = q;
+    }
+}
+
+void HazardPointers::retire(void* p, void (*deleter)(void*)) {
+    Local& l = local();
+    l.retired.push_back({p, deleter});
+    if (l.retired.size() >= scanThreshold)
+        scan(l);
+}
+
+void HazardPointers::scan(Local& l) {
+    if (haveOrphans.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(orphanLock);
+        l.retired.insert(l.retired.end(), orphans.begin(), orphans.end());
+        orphans.clear();
+        haveOrphans.store(false, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::vector<void*> hazards;
+    for (Record& r : records) {
+        if (!r.active.load(std::memory_order_acquire))
+            continue;
+        for (std::atomic<void*>& h : r.hp) {
+            void* p = h.load(std::memory_order_seq_cst);
+            if (p != nullptr)
+                hazards.push_back(p);
+        }
+    }
+    std::sort(hazards.begin(), hazards.end());
+    std::vector<Retired> keep;
+    for (Retired& r : l.retired) {
+        if (std::binary_search(hazards.begin(), hazards.end(), r.p))
+            keep.push_back(r);
+        else
+            r.deleter(r.p);
+    }
+    l.retired.swap(keep);
+}
+
+HazardPointers::Local::Local() {
+    for (Record& r : records) {
+        bool expected = false;
+        if (!r.active.load(std::memory_order_relaxed) &&
+            r.active.compare_exchange_strong(expected, true)) {
+            rec = &r;
+            return;
+        }
+    }
+    throw std::runtime_error("More than " + std::to_string(maxThreads) +
+                             " threads using hazard pointers at once");
+}
+
+HazardPointers::Local::~Local() {
+    for (std::atomic<void*>& h : rec->hp)
+        h.store(nullptr, std::memory_order_release);
+    scan(*this);
+    if (!retired.empty()) {
+        std::lock_guard<std::mutex> lock(orphanLock);
+        orphans.insert(orphans.end(), retired.begin(), retired.end());
+        haveOrphans.store(true, std::memory_order_relaxed);
+    }
+    rec->active.store(false, std::memory_order_release);
+}
+
+
+
+
+/*
+Unbounded multi producer / multi consumer queue (Michael & Scott, 1996).
+
+A singly linked chain like Queue's, which always begins with a dummy node :
+the values are in the nodes after `head`, and `tail` is the last node or
+(briefly) the one before it.
+- enqueue links a new node after the last one with a CAS on its `next`,
+  then tries to swing `tail` forward. If that CAS loses, whichever thread
+  next sees `tail` lagging behind moves it on instead of waiting.
+- dequeue makes the node after `head` the new dummy with a CAS on `head`,
+  and only then moves its value out, since from then on no other thread
+  looks at it. The old dummy is retired through hazard pointers, which also
+  protect the nodes being read from being freed.
+
+The nodes need an atomic `next`, so they're a separate type from ListNode.
+Any number of threads may enqueue & dequeue concurrently. Since the front
+of the queue can change at any moment, there is no front()/back(); use
+try_dequeue. size() is only exact when no operations are in progress.
+*/
+template <typename T = int>
+class ConcurrentQueue {
+
+    struct Node {
+        std::atomic<Node*> next {nullptr};
+        T val;
+        template <typename... Args>
+        Node(Args&&... args) : val(std::forward<Args>(args)...) {}
+    };
+
+    alignas(cacheLine) std::atomic<Node*> head;
+    alignas(cacheLine) std::atomic<Node*> tail;
+    alignas(cacheLine) std::atomic<int> count {0};
+
+    public :
+        ConcurrentQueue() {head = tail = new Node();}
+        ~ConcurrentQueue();
+        ConcurrentQueue(const ConcurrentQueue&) = delete;
+        ConcurrentQueue& operator=(const ConcurrentQueue&) = delete;
+
+        void enqueue(const T& val) {emplace(val);}
+        void enqueue(T&& val) {emplace(std::move(val));}
+        template <typename... Args>
+        void emplace(Args&&...);
+        bool try_dequeue(T&);
+        T dequeue();
+        int size() const {return std::max(0, count.load(std::memory_order_relaxed));}
+        bool empty() const {
+            return head.load(std::memory_order_acquire)->next.load(
+                std::memory_order_acquire) == nullptr;
+        }
+};
+
+template <typename T>
+ConcurrentQueue<T>::~ConcurrentQueue() {
+    // No other thread may be using the queue by now
+    Node* n = head.load(std::memory_order_relaxed);
+    while (n != nullptr) {
+        Node* nx = n->next.load(std::memory_order_relaxed);
+        delete n;
+        n = nx;
+    }
+}
+
+
+template <typename T>
+template <typename... Args>
+void ConcurrentQueue<T>::emplace(Args&&... args) {
+    Node* n = new Node(std::forward<Args>(args)...);
+    while (true) {
+        Node* t = HazardPointers::protect(0, tail);
+        Node* next = t->next.load(std::memory_order_acquire);
+        if (t != tail.load(std::memory_order_acquire))
+            continue;
+        if (next != nullptr) {
+            // Tail is lagging behind, help move it on
+            tail.compare_exchange_weak(t, next, std::memory_order_release,
+                                       std::memory_order_relaxed);
+            continue;
+        }
+        if (t->next.compare_exchange_weak(next, n, std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+            tail.compare_exchange_strong(t, n, std::memory_order_release,
+                                         std::memory_order_relaxed);
+            break;
+        }
+    }
+    HazardPointers::clear(0);
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <typename T>
+bool ConcurrentQueue<T>::try_dequeue(T& val) {
+    while (true) {
+        Node* h = HazardPointers::protect(0, head);
+        Node* t = tail.load(std::memory_order_acquire);
+        Node* next = HazardPointers::protect(1, h->next);
+        if (h != head.load(std::memory_order_acquire))
+            continue;
+        if (next == nullptr) {
+            HazardPointers::clear(0);
+            HazardPointers::clear(1);
+            return false;   // Empty
+        }
+        if (h == t) {
+            // Don't let head pass a lagging tail
+            tail.compare_exchange_weak(t, next, std::memory_order_release,
+                                       std::memory_order_relaxed);
+            continue;
+        }
+        if (head.compare_exchange_weak(h, next, std::memory_order_acq_rel,
+                                       std::memory_order_relaxed)) {
+            // `next` is the dummy now, still protected by slot 1
+            val = std::move(next->val);
+            HazardPointers::clear(0);
+            HazardPointers::clear(1);
+            HazardPointers::retire(h);
+            count.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+}
+
+template <typename T>
+T ConcurrentQueue<T>::dequeue() {
+    T val;
+    if (!try_dequeue(val))
+        throw std::out_of_range("Queue is empty");
+    return val;
+}
+
+
+
+
+/*
+Lock-free stack (Treiber, 1986) with an elimination array (Hendler, Shavit
+& Yerushalmi, 2004).
+
+push links a new node above the current top, and pop replaces the top with
+the node below it, each with a single CAS on `top`. pop protects the top node
+with a hazard pointer before reading it, so it can't be freed & reused at
+the same address in the meantime; that rules out the ABA problem, where a
+CAS succeeds because `top` went from A to B and back to a new A, installing
+a stale `next`.
+
+Every operation on `top` is a write to the same cache line, so under
+contention most CASes fail. A thread whose CAS failed then tries to meet an
+opposite operation in a random slot of the elimination array instead : a
+push leaves its node in an empty slot for a short while, and a pop that
+finds a node there claims it by swapping in the `taken` marker. The pair
+cancels out without touching `top` at all, which is a valid outcome since
+a push immediately followed by a pop leaves the stack unchanged. Either
+side retries on `top` if no partner turns up.
+
+Same interface as Stack except that values are returned rather than nodes,
+with a non-throwing try_pop. There is no top(), since the top can change at
+any moment. size() is only exact when no operations are in progress.
+*/
+template <typename T = int>
+class ConcurrentStack {
+
+    struct Node {
+        Node* next = nullptr;   // Never changes once the node is pushed
+        T val;
+        Node() = default;
+        template <typename... Args>
+        Node(Args&&... args) : val(std::forward<Args>(args)...) {}
+    };
+
+    static const int slots = 8;
+    static const int patience = 128;    // Spins a push waits in a slot
+    struct alignas(cacheLine) Slot {
+        std::atomic<Node*> node {nullptr};
+    };
+    static Node* taken() {static Node t; return &t;}
+
+    alignas(cacheLine) std::atomic<Node*> top {nullptr};
+    alignas(cacheLine) std::atomic<int> count {0};
+    Slot elimination[slots];
+
+    static unsigned randomSlot();
+    bool eliminatePush(Node*);
+    bool eliminatePop(T&);
+
+    public :
+        ConcurrentStack() = default;
+        ~ConcurrentStack();
+        ConcurrentStack(const ConcurrentStack&) = delete;
+        ConcurrentStack& operator=(const ConcurrentStack&) = delete;
+
+        void push(const T& val) {emplace(val);}
+        void push(T&& val) {emplace(std::move(val));}
+        template <typename... Args>
+        void emplace(Args&&...);
+        bool try_pop(T&);
+        T pop();
+        int size() const {return std::max(0, count.load(std::memory_order_relaxed));}
+        bool empty() const {return top.load(std::memory_order_acquire) == nullptr;}
+};
+
+template <typename T>
+ConcurrentStack<T>::~ConcurrentStack() {
+    // No other thread may be using the stack by now
+    Node* n = top.load(std::memory_order_relaxed);
+    while (n != nullptr) {
+        Node* nx = n->next;
+        delete n;
+        n = nx;
+    }
+}
+
+template <typename T>
+unsigned ConcurrentStack<T>::randomSlot() {
+    // xorshift, seeded differently in each thread
+    thread_local unsigned x = 2463534242u ^
+        unsigned(reinterpret_cast<std::size_t>(&x) >> 4);
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    return x % slots;
+}
+
+
+template <typename T>
+template <typename... Args>
+void ConcurrentStack<T>::emplace(Args&&... args) {
+    Node* n = new Node(std::forward<Args>(args)...);
+    count.fetch_add(1, std::memory_order_relaxed);
+    while (true) {
+        Node* t = top.load(std::memory_order_relaxed);
+        n->next = t;
+        if (top.compare_exchange_weak(t, n, std::memory_order_release,
+                                      std::memory_order_relaxed))
+            return;
+        if (eliminatePush(n))
+            return;
+    }
+}
+
+template <typename T>
+bool ConcurrentStack<T>::try_pop(T& val) {
+    while (true) {
+        Node* t = HazardPointers::protect(0, top);
+        if (t == nullptr) {
+            HazardPointers::clear(0);
+            return false;   // Empty
+        }
+        if (top.compare_exchange_weak(t, t->next, std::memory_order_acquire,
+                                      std::memory_order_relaxed)) {
+            HazardPointers::clear(0);
+            val = std::move(t->val);
+            HazardPointers::retire(t);
+            count.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        HazardPointers::clear(0);
+        if (eliminatePop(val)) {
+            count.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+}
+
+template <typename T>
+T ConcurrentStack<T>::pop() {
+    T val;
+    if (!try_pop(val))
+        throw std::out_of_range("Stack is empty");
+    return val;
+}
+
+
+template <typename T>
+bool ConcurrentStack<T>::eliminatePush(Node* n) {
+    // True if a pop took the node. Only the pop dereferences it from then
+    // on (and frees it), the push only looks at the slot's value
+    Slot& s = elimination[randomSlot()];
+    Node* expected = nullptr;
+    if (!s.node.compare_exchange_strong(expected, n, std::memory_order_release,
+                                        std::memory_order_relaxed))
+        return false;
+    for (int i = 0; i < patience; ++i) {
+        if (s.node.load(std::memory_order_acquire) == taken()) {
+            s.node.store(nullptr, std::memory_order_release);
+            return true;
+        }
+    }
+    expected = n;
+    if (s.node.compare_exchange_strong(expected, nullptr,
+            std::memory_order_acquire, std::memory_order_acquire))
+        return false;   // Withdrawn, nobody came
+    s.node.store(nullptr, std::memory_order_release);
+    return true;        // Taken just before withdrawing
+}
+
+template <typename T>
+bool ConcurrentStack<T>::eliminatePop(T& val) {
+    Slot& s = elimination[randomSlot()];
+    Node* n = s.node.load(std::memory_order_acquire);
+    if (n == nullptr || n == taken())
+        return false;
+    if (!s.node.compare_exchange_strong(n, taken(), std::memory_order_acq_rel,
+                                        std::memory_order_relaxed))
+        return false;
+    val = std::move(n->val);
+    delete n;
+    return true;
+}
@@ -0,0 +1,392 @@
+#pragma once
+
+#include <initializer_list>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "sqll.hpp"
+
+
+
+template <typename T> class DoublyLinkedList;
+
+/*
+A ListNode that also links back to the previous node, so that a list can be
+walked (and unlinked from) in both directions. prv() is the backward nxt().
+It takes one more pointer per node : 24 bytes instead of 16 for an int.
+*/
+template <typename T = int>
+struct DListNode : ListNode<T> {
+
+    protected :
+        DListNode* prev = nullptr;
+    friend class DoublyLinkedList<T>;
+    friend class NodePool<T, DListNode<T>>;
+
+        DListNode(typename ListNode<T>::Uninit u) : ListNode<T>(u) {}
+
+    public :
+        using ListNode<T>::ListNode;
+        using ListNode<T>::operator=;
+        DListNode() = default;
+        // Sets the value only, like for a ListNode
+        DListNode& operator=(const DListNode& n) {
+            this->val = n.val; return *this;
+        }
+
+        DListNode* nxt() const {return static_cast<DListNode*>(this->next);}
+        DListNode* prv() const {return prev;}
+};
+
+
+
+/*
+LinkedList with doubly linked nodes. It has the same positional interface
+(operator[], insert/emplace, append/emplace_back, remove, clear, splice,
+print), plus :
+- O(1) insertion & removal at both ends (emplace_front, pop_front,
+  pop_back), where LinkedList has to walk the whole list to remove its last
+  value.
+- Positional operations walk from whichever end is closer to the index, so
+  they take at most l/2 steps instead of l.
+Nodes come from their own NodePool, like a LinkedList's.
+*/
+template <typename T = int>
+class DoublyLinkedList {
+
+    protected :
+        using Node = DListNode<T>;
+
+        Node* start = nullptr;
+        Node* end = nullptr;
+        int l = 0;
+
+        template <typename... Args>
+        static Node* newNode(Args&&...);
+        static void freeNode(Node*);
+
+        Node* nodeAt(int);
+        void linkBefore(Node*, Node*);
+        T unlink(Node*);
+
+    public :
+        DoublyLinkedList() = default;
+        DoublyLinkedList(const std::initializer_list<T>&);
+        DoublyLinkedList(const DoublyLinkedList&);
+        DoublyLinkedList(DoublyLinkedList&&) noexcept;
+        DoublyLinkedList& operator=(const DoublyLinkedList&);
+        DoublyLinkedList& operator=(DoublyLinkedList&&) noexcept;
+        ~DoublyLinkedList() {clear();}
+
+        int size() {return l;}
+        Node* startnode() {return start;}
+        Node* endnode() {return end;}
+        Node& operator[](int);
+        template <typename... Args>
+        Node& emplace(int, Args&&...);
+        Node& insert(int i, const T& val) {return emplace(i, val);}
+        Node& insert(int i, T&& val) {return emplace(i, std::move(val));}
+        template <typename... Args>
+        Node& emplace_back(Args&&... args) {
+            Node* nn = newNode(std::forward<Args>(args)...);
+            linkBefore(nn, nullptr);
+            return *nn;
+        }
+        Node& append(const T& val) {return emplace_back(val);}
+        Node& append(T&& val) {return emplace_back(std::move(val));}
+        template <typename... Args>
+        Node& emplace_front(Args&&... args) {
+            Node* nn = newNode(std::forward<Args>(args)...);
+            linkBefore(nn, start);
+            return *nn;
+        }
+        T remove(int);
+        T pop_front();
+        T pop_back();
+        void clear();
+        void splice(DoublyLinkedList&);
+        void splice(DoublyLinkedList&& o) {splice(o);}
+        void print(const std::string& = " ", const std::string& = "\n",
+                   std::ostream& = std::cout);
+};
+
+
+template <typename T>
+template <typename... Args>
+DListNode<T>* DoublyLinkedList<T>::newNode(Args&&... args) {
+#ifdef SQLL_NO_POOL
+    Node* n = new Node(typename Node::Uninit());
+    try {
+        new (&n->val) T(std::forward<Args>(args)...);
+    } catch (...) {
+        ::operator delete(n);
+        throw;
+    }
+    return n;
+#else
+    return NodePool<T, Node>::get(std::forward<Args>(args)...);
+#endif
+}
+
+template <typename T>
+void DoublyLinkedList<T>::freeNode(Node* n) {
+#ifdef SQLL_NO_POOL
+    delete n;
+#else
+    n->val.~T();
+    NodePool<T, Node>::put(n);
+#endif
+}
+
+
+template <typename T>
+DoublyLinkedList<T>::DoublyLinkedList(const std::initializer_list<T>& il) {
+    for (const T& x : il)
+        emplace_back(x);
+}
+
+template <typename T>
+DoublyLinkedList<T>::DoublyLinkedList(const DoublyLinkedList& o) {
+    for (Node* n = o.start; n != nullptr; n = n->nxt())
+        emplace_back(n->val);
+}
+
+template <typename T>
+DoublyLinkedList<T>::DoublyLinkedList(DoublyLinkedList&& o) noexcept
+    : start(o.start), end(o.end), l(o.l) {
+    o.start = o.end = nullptr;
+    o.l = 0;
+}
+
+template <typename T>
+DoublyLinkedList<T>& DoublyLinkedList<T>::operator=(const DoublyLinkedList& o) {
+    if (this != &o) {
+        DoublyLinkedList copy(o);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+template <typename T>
+DoublyLinkedList<T>& DoublyLinkedList<T>::operator=(DoublyLinkedList&& o) noexcept {
+    if (this != &o) {
+        clear();
+        std::swap(start, o.start);
+        std::swap(end, o.end);
+        std::swap(l, o.l);
+    }
+    return *this;
+}
+
+
+template <typename T>
+DListNode<T>* DoublyLinkedList<T>::nodeAt(int i) {
+    // From the front for the first half, from the back for the second
+    Node* n;
+    if (i < l / 2) {
+        n = start;
+        for (int a = 0; a < i; ++a)
+            n = n->nxt();
+    } else {
+        n = end;
+        for (int a = l - 1; a > i; --a)
+            n = n->prev;
+    }
+    return n;
+}
+
+template <typename T>
+void DoublyLinkedList<T>::linkBefore(Node* nn, Node* at) {
+    // Links nn in before `at`, or at the end if `at` is nullptr
+    Node* p = (at != nullptr) ? at->prev : end;
+    nn->next = at;
+    nn->prev = p;
+    if (p != nullptr)
+        p->next = nn;
+    else
+        start = nn;
+    if (at != nullptr)
+        at->prev = nn;
+    else
+        end = nn;
+    ++l;
+}
+
+template <typename T>
+T DoublyLinkedList<T>::unlink(Node* n) {
+    // Takes n out of the list, and frees it. Returns its value
+    if (n->prev != nullptr)
+        n->prev->next = n->next;
+    else
+        start = n->nxt();
+    if (n->next != nullptr)
+        n->nxt()->prev = n->prev;
+    else
+        end = n->prev;
+    --l;
+    T val = std::move(n->val);
+    freeNode(n);
+    return val;
+}
+
+
+template <typename T>
+DListNode<T>& DoublyLinkedList<T>::operator[](int i) {
+    if (i<0 || i>=l) {
+        throw std::out_of_range("Invalid index " + std::to_string(i) + \
+        ". Extent is 0.." + std::to_string((l>0)?l-1:0));
+    }
+    return *nodeAt(i);
+}
+
+template <typename T>
+template <typename... Args>
+DListNode<T>& DoublyLinkedList<T>::emplace(int i, Args&&... args) {
+    if (i<0 || i>l) {
+        throw std::out_of_range("Invalid insertion index " + std::to_string(i) + \
+        ". Extent is 0.." + std::to_string(l));
+    }
+    Node* at = (i == l) ? nullptr : nodeAt(i);
+    Node* nn = newNode(std::forward<Args>(args)...);
+    linkBefore(nn, at);
+    return *nn;
+}
+
+template <typename T>
+T DoublyLinkedList<T>::remove(int i) {
+    if (i<0 || i>=l) {
+        throw std::out_of_range("Invalid deletion index " + std::to_string(i) + \
+        ". Extent is 0.." + std::to_string((l>0)?l-1:0));
+    }
+    return unlink(nodeAt(i));
+}
+
+template <typename T>
+T DoublyLinkedList<T>::pop_front() {
+    if (l == 0)
+        throw std::out_of_range("List is empty");
+    return unlink(start);
+}
+
+template <typename T>
+T DoublyLinkedList<T>::pop_back() {
+    if (l == 0)
+        throw std::out_of_range("List is empty");
+    return unlink(end);
+}
+
+template <typename T>
+void DoublyLinkedList<T>::clear() {
+    // Handed back to the pool all at once, like LinkedList::clear
+    if (start != nullptr) {
+#ifdef SQLL_NO_POOL
+        for (Node* n = start; n != nullptr; ) {
+            Node* nx = n->nxt();
+            delete n;
+            n = nx;
+        }
+#else
+        if (!std::is_trivially_destructible<T>::value) {
+            for (Node* n = start; n != nullptr; n = n->nxt())
+                n->val.~T();
+        }
+        NodePool<T, Node>::putChain(start, end, l);
+#endif
+    }
+    l = 0;
+    start = nullptr;
+    end = nullptr;
+}
+
+template <typename T>
+void DoublyLinkedList<T>::splice(DoublyLinkedList& o) {
+    // Appends all of o and empties it, in O(1)
+    if (&o == this || o.start == nullptr)
+        return;
+    if (start == nullptr)
+        start = o.start;
+    else
+        end->next = o.start;
+    o.start->prev = end;
+    end = o.end;
+    l += o.l;
+    o.start = o.end = nullptr;
+    o.l = 0;
+}
+
+template <typename T>
+void DoublyLinkedList<T>::print(const std::string& sep, const std::string& fin,
+                                std::ostream& stream) {
+    for (Node* n = start; n != nullptr; n = n->nxt()) {
+        stream << n->val;
+        if (n != end)
+            stream << sep;
+    }
+    stream << fin;
+}
+
+
+
+/*
+Deque, based on the DoublyLinkedList : a Queue that can also push at the
+front & pop at the back, all in O(1). operator[] walks from the nearer end.
+*/
+template <typename T = int>
+class Deque : private DoublyLinkedList<T> {
+
+    using Base = DoublyLinkedList<T>;
+
+    public :
+        using Base::Base;
+        using Base::size;
+        using Base::print;
+        using Base::clear;
+        using Base::operator[];
+
+        DListNode<T>& push_back(const T& val) {
+            return this->emplace_back(val);
+        }
+        DListNode<T>& push_back(T&& val) {
+            return this->emplace_back(std::move(val));
+        }
+        DListNode<T>& push_front(const T& val) {
+            return this->emplace_front(val);
+        }
+        DListNode<T>& push_front(T&& val) {
+            return this->emplace_front(std::move(val));
+        }
+        using Base::emplace_back;
+        using Base::emplace_front;
+        T pop_front() {
+            if (this->l>0)
+                return Base::pop_front();
+            else
+                throw std::out_of_range("Deque is empty");
+        }
+        T pop_back() {
+            if (this->l>0)
+                return Base::pop_back();
+            else
+                throw std::out_of_range("Deque is empty");
+        }
+        // Appends all of o, and empties it, in O(1)
+        void splice(Deque& o) {
+            Base::splice(o);
+        }
+        DListNode<T>& front() {
+            if (this->start != nullptr)
+                return *this->start;
+            else
+                throw std::out_of_range("Deque is empty");
+        }
+        DListNode<T>& back() {
+            if (this->end != nullptr)
+                return *this->end;
+            else
+                throw std::out_of_range("Deque is empty");
+        }
+};
@@ -0,0 +1,62 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "sqll.hpp"
+#include "indexed.hpp"
+
+/*
+Positional workload on LinkedList vs IndexedList : random insert(i, ..),
+remove(i) & operator[] at growing sizes, plus a full traversal with nxt().
+
+    ./indexed-bench [max size]
+
+Compile with -O2 -DNDEBUG.
+*/
+
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+
+template <typename List>
+void run(const string& name, int n, int ops) {
+    List list;
+    mt19937 rng(5);
+    for (int i = 0; i < n; ++i)
+        list.append(i);
+    long long sink = 0;
+    Clock::time_point t0 = Clock::now();
+    for (int i = 0; i < ops; ++i) {
+        switch (i % 3) {
+            case 0 : list.insert(rng() % (list.size() + 1), i); break;
+            case 1 : sink += list[rng() % list.size()]; break;
+            case 2 : sink += list.remove(rng() % list.size()); break;
+        }
+    }
+    double ns = chrono::duration<double, nano>(Clock::now() - t0).count() / ops;
+    t0 = Clock::now();
+    for (ListNode<>* p = list.startnode(); p != nullptr; p = p->nxt())
+        sink += p->val;
+    double walk = chrono::duration<double, nano>(Clock::now() - t0).count() / n;
+    cout << left << setw(14) << name << right << setw(10) << n << fixed
+         << setprecision(1) << setw(14) << ns << setw(14) << walk
+         << ((sink == 42) ? " " : "") << '\n';
+}
+
+
+int main(int argc, char* argv[]) {
+    int maxn = (argc > 1) ? atoi(argv[1]) : 100000;
+    cout << left << setw(14) << "" << right << setw(10) << "size"
+         << setw(14) << "ns/pos. op" << setw(14) << "ns/nxt()" << '\n';
+    for (int n = 1000; n <= maxn; n *= 10) {
+        // Fewer ops at larger sizes, or LinkedList takes forever
+        int ops = max(3000, 30000000 / n);
+        run<LinkedList<>>("LinkedList", n, ops);
+        run<IndexedList<>>("IndexedList", n, ops);
+    }
+    return 0;
+}
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+
+#include "sqll.hpp"
+
+
+
+/*
+Indexable skip list : a LinkedList with the same positional interface, where
+operator[], insert(i, ..) and remove(i) take O(log N) expected time instead
+of walking from the start.
+
+The elements are still an ordinary chain of ListNodes (level 0), so
+traversing with nxt() costs exactly what it does on a LinkedList. On top of
+that, about 1 node in 4 also appears in level 1, 1 in 16 in level 2 and so
+on, as `Link`s which point to the next Link of the same level. Each Link
+records its `span`, the number of positions it skips, so that a search for
+index i can go right along a level as long as the sum of spans stays <= i,
+then drop down a level. Only the last few steps are taken along level 0.
+
+Positions count from -1 (the heads of the levels) to l (past the end), so a
+Link without a right neighbour spans up to l.
+*/
+template <typename T = int>
+class IndexedList : private LinkedList<T> {
+
+    using Base = LinkedList<T>;
+    using Node = ListNode<T>;
+    using Base::start;
+    using Base::end;
+    using Base::l;
+
+    static const int maxLevel = 16;     // 4^16 elements is plenty
+
+    struct Link {
+        Link* right;
+        Link* down;         // Same node, one level lower (nullptr at level 1)
+        Node* node;
+        int span;
+    };
+
+    Link head[maxLevel];    // head[k] starts level k+1
+    int levels = 0;         // Levels above 0 in use
+    unsigned rng = 2463534242u;
+
+    int randomHeight();
+    void addLevels(int);
+    void findPreds(int, Link**, int*);
+    Node* nodeBefore(Link*, int, int);
+    void clearLinks();
+
+    public :
+        IndexedList();
+        IndexedList(const std::initializer_list<T>&);
+        ~IndexedList() {clearLinks();}
+        IndexedList(const IndexedList&) = delete;
+        IndexedList& operator=(const IndexedList&) = delete;
+
+        using Base::size;
+        using Base::startnode;
+        using Base::print;
+
+        Node& operator[](int);
+        template <typename... Args>
+        Node& emplace(int, Args&&...);
+        Node& insert(int i, const T& val) {return emplace(i, val);}
+        Node& insert(int i, T&& val) {return emplace(i, std::move(val));}
+        template <typename... Args>
+        Node& emplace_back(Args&&... args) {
+            return emplace(l, std::forward<Args>(args)...);
+        }
+        Node& append(const T& val) {return emplace(l, val);}
+        Node& append(T&& val) {return emplace(l, std::move(val));}
+        T remove(int);
+        void clear() {clearLinks(); Base::clear();}
+};
+
+
+template <typename T>
+IndexedList<T>::IndexedList() {
+    for (int k = 0; k < maxLevel; ++k)
+        head[k] = {nullptr, (k > 0) ? &head[k-1] : nullptr, nullptr, 1};
+}
+
+template <typename T>
+IndexedList<T>::IndexedList(const std::initializer_list<T>& il)
+    : IndexedList() {
+    // Built left to right in O(N), keeping the last Link of every level
+    Link* tail[maxLevel];
+    int tailpos[maxLevel];
+    for (int k = 0; k < maxLevel; ++k) {
+        tail[k] = &head[k];
+        tailpos[k] = -1;
+    }
+    for (const T& x : il) {
+        Node* nn = Base::newNode(x);
+        if (start == nullptr)
+            start = nn;
+        else
+            end->next = nn;
+        end = nn;
+        int h = randomHeight();
+        if (h > levels)
+            levels = h;
+        Link* below = nullptr;
+        for (int k = 0; k < h; ++k) {
+            Link* nl = new Link {nullptr, below, nn, 0};
+            tail[k]->right = nl;
+            tail[k]->span = l - tailpos[k];
+            tail[k] = nl;
+            tailpos[k] = l;
+            below = nl;
+        }
+        ++l;
+    }
+    for (int k = 0; k < maxLevel; ++k)
+        tail[k]->span = l - tailpos[k];
+}
+
+
+template <typename T>
+int IndexedList<T>::randomHeight() {
+    // Number of levels above 0 for a new node, P(>= k) = 1/4^k
+    unsigned x = rng;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    rng = x;
+    int h = 0;
+    while ((x & 3) == 0 && h < maxLevel) {
+        ++h;
+        x >>= 2;
+    }
+    return h;
+}
+
+template <typename T>
+void IndexedList<T>::addLevels(int h) {
+    for (; levels < h; ++levels) {
+        head[levels].right = nullptr;
+        head[levels].span = l + 1;
+    }
+}
+
+template <typename T>
+void IndexedList<T>::findPreds(int i, Link** pred, int* pos) {
+    // For every level in use, the last Link before position i, and its position
+    Link* cur = &head[levels - 1];
+    int r = -1;
+    for (int k = levels - 1; k >= 0; --k) {
+        while (cur->right != nullptr && r + cur->span < i) {
+            r += cur->span;
+            cur = cur->right;
+        }
+        pred[k] = cur;
+        pos[k] = r;
+        cur = cur->down;
+    }
+}
+
+template <typename T>
+ListNode<T>* IndexedList<T>::nodeBefore(Link* from, int r, int i) {
+    // The node at position i-1 (nullptr for i = 0), walking level 0 from
+    // `from` at position r
+    Node* n = (r < 0) ? nullptr : from->node;
+    for (; r < i - 1; ++r)
+        n = (n == nullptr) ? start : n->next;
+    return n;
+}
+
+template <typename T>
+void IndexedList<T>::clearLinks() {
+    for (int k = 0; k < levels; ++k) {
+        Link* c = head[k].right;
+        while (c != nullptr) {
+            Link* nx = c->right;
+            delete c;
+            c = nx;
+        }
+        head[k].right = nullptr;
+        head[k].span = 1;
+    }
+    levels = 0;
+}
+
+
+template <typename T>
+ListNode<T>& IndexedList<T>::operator[](int i) {
+    if (i<0 || i>=l) {
+        throw std::out_of_range("Invalid index " + std::to_string(i) + \
+        ". Extent is 0.." + std::to_string((l>0)?l-1:0));
+    }
+    if (i == l-1)
+        return *end;
+    Link* pred[maxLevel];
+    int pos[maxLevel];
+    if (levels == 0)
+        return *nodeBefore(nullptr, -1, i + 1);
+    findPreds(i + 1, pred, pos);
+    return *nodeBefore(pred[0], pos[0], i + 1);
+}
+
+template <typename T>
+template <typename... Args>
+ListNode<T>& IndexedList<T>::emplace(int i, Args&&... args) {
+    if (i<0 || i>l) {
+        throw std::out_of_range("Invalid insertion index " + std::to_string(i) + \
+        ". Extent is 0.." + std::to_string(l));
+    }
+    int h = randomHeight();
+    addLevels(h);
+    Link* pred[maxLevel];
+    int pos[maxLevel];
+    Node* p;
+    if (levels > 0) {
+        findPreds(i, pred, pos);
+        p = nodeBefore(pred[0], pos[0], i);
+    } else {
+        p = nodeBefore(nullptr, -1, i);
+    }
+
+    Node* nn = Base::newNode(std::forward<Args>(args)...);
+    if (p == nullptr) {
+        nn->next = start;
+        start = nn;
+    } else {
+        nn->next = p->next;
+        p->next = nn;
+    }
+    if (i == l)
+        end = nn;
+
+    // Levels the node is in get a new Link, which takes over the part of
+    // its predecessor's span after position i. Levels above just skip one more
+    Link* below = nullptr;
+    for (int k = 0; k < levels; ++k) {
+        if (k < h) {
+            Link* nl = new Link {pred[k]->right, below, nn,
+                                 pos[k] + pred[k]->span + 1 - i};
+            pred[k]->right = nl;
+            pred[k]->span = i - pos[k];
+            below = nl;
+        } else {
+            ++pred[k]->span;
+        }
+    }
+    ++l;
+    return *nn;
+}
+
+template <typename T>
+T IndexedList<T>::remove(int i) {
+    if (i<0 || i>=l) {
+        throw std::out_of_range("Invalid deletion index " + std::to_string(i) + \
+        ". Extent is 0.." + std::to_string((l>0)?l-1:0));
+    }
+    Link* pred[maxLevel];
+    int pos[maxLevel];
+    Node* p;
+    if (levels > 0) {
+        findPreds(i, pred, pos);
+        p = nodeBefore(pred[0], pos[0], i);
+        for (int k = 0; k < levels; ++k) {
+            Link* t = pred[k]->right;
+            if (t != nullptr && pos[k] + pred[k]->span == i) {
+                pred[k]->span += t->span - 1;
+                pred[k]->right = t->right;
+                delete t;
+            } else {
+                --pred[k]->span;
+            }
+        }
+        while (levels > 0 && head[levels-1].right == nullptr)
+            --levels;
+    } else {
+        p = nodeBefore(nullptr, -1, i);
+    }
+
+    Node* temp = (p == nullptr) ? start : p->next;
+    if (p == nullptr)
+        start = temp->next;
+    else
+        p->next = temp->next;
+    if (temp == end)
+        end = p;
+    --l;
+    T val = std::move(temp->val);
+    Base::freeNode(temp);
+    return val;
+}
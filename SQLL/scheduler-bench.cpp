@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+#include "scheduler.hpp"
+
+/*
+Scaling of the fork-join scheduler (scheduler.hpp) with the number of
+worker threads, on two divide & conquer workloads :
+- fib : naive recursive Fibonacci, spawning a task per call above a cutoff
+  (lots of tiny tasks, measures scheduling overhead)
+- sum : parallel sum of a large array, split in halves recursively
+  (memory bound, measures load balancing)
+
+    ./scheduler-bench [fib n] [array size]
+
+Compile with -O2 -DNDEBUG -pthread.
+*/
+
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+const int fibCutoff = 12;
+const long sumCutoff = 1 << 14;
+
+
+long fibSerial(int n) {
+    return (n < 2) ? n : fibSerial(n-1) + fibSerial(n-2);
+}
+
+long fib(Scheduler& s, int n) {
+    if (n < fibCutoff)
+        return fibSerial(n);
+    long a, b;
+    TaskGroup g(s);
+    g.run([&] {a = fib(s, n-1);});
+    b = fib(s, n-2);
+    g.wait();
+    return a + b;
+}
+
+long sum(Scheduler& s, const int* p, long n) {
+    if (n <= sumCutoff)
+        return accumulate(p, p + n, 0L);
+    long a, b;
+    TaskGroup g(s);
+    g.run([&] {a = sum(s, p, n/2);});
+    b = sum(s, p + n/2, n - n/2);
+    g.wait();
+    return a + b;
+}
+
+
+template <typename F>
+double timeIt(F f) {
+    Clock::time_point t0 = Clock::now();
+    f();
+    return chrono::duration<double, milli>(Clock::now() - t0).count();
+}
+
+int main(int argc, char* argv[]) {
+    int n = (argc > 1) ? atoi(argv[1]) : 32;
+    long len = (argc > 2) ? atol(argv[2]) : (1L << 25);
+    vector<int> data(len);
+    iota(data.begin(), data.end(), 0);
+    unsigned maxthreads = max(4u, thread::hardware_concurrency());
+
+    long fs, ss;
+    double fib1 = timeIt([&] {fs = fibSerial(n);});
+    double sum1 = timeIt([&] {ss = accumulate(data.begin(), data.end(), 0L);});
+    cout << "fib(" << n << ") & sum of " << len << " ints\n\n"
+         << setw(8) << "threads" << setw(12) << "fib ms" << setw(10) << "speedup"
+         << setw(12) << "sum ms" << setw(10) << "speedup\n"
+         << setw(8) << "serial" << fixed << setprecision(1) << setw(12) << fib1
+         << setw(10) << 1.0 << setw(12) << sum1 << setw(10) << 1.0 << '\n';
+
+    for (unsigned t = 1; t <= maxthreads; t *= 2) {
+        Scheduler s(t);
+        long fp, sp;
+        double fibt = timeIt([&] {fp = fib(s, n);});
+        double sumt = timeIt([&] {sp = sum(s, data.data(), len);});
+        cout << setw(8) << t << setw(12) << fibt << setw(10) << fib1 / fibt
+             << setw(12) << sumt << setw(10) << sum1 / sumt
+             << ((fp == fs && sp == ss) ? "" : "  WRONG RESULT") << '\n';
+    }
+    return 0;
+}
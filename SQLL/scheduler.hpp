@@ -0,0 +1,387 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "concurrent.hpp"
+
+
+
+/*
+Work-stealing deque (Chase & Lev, 2005; with the memory orderings of
+Lê, Pop, Cohen & Zappa Nardelli, 2013).
+
+Its owner thread pushes & takes at the bottom end, like a Stack, without any
+locked instruction except when taking the very last element. Any other
+thread may steal from the top end, with one CAS on `top`. So the owner works
+depth first on its newest (smallest, cache hot) tasks, while thieves take
+its oldest ones, which in fork-join programs are the biggest.
+
+The elements live in a circular array that the owner doubles when full.
+Thieves may still be reading an old array at that point, so old arrays are
+only freed along with the deque.
+T must be trivially copyable (it's meant for pointers).
+*/
+template <typename T>
+class WorkStealingDeque {
+
+    struct Array {
+        long size;
+        std::unique_ptr<std::atomic<T>[]> buf;
+        Array(long n) : size(n), buf(new std::atomic<T>[n]) {}
+        // Slots are release/acquire too (free on x86), so that what a task
+        // pointer points to is visible to the thief that reads it
+        T get(long i) {return buf[i & (size-1)].load(std::memory_order_acquire);}
+        void put(long i, T x) {buf[i & (size-1)].store(x, std::memory_order_release);}
+    };
+
+    alignas(cacheLine) std::atomic<long> top {0};
+    alignas(cacheLine) std::atomic<long> bottom {0};
+    std::atomic<Array*> array;
+    std::vector<std::unique_ptr<Array>> arrays;     // Current & retired
+
+    Array* grow(Array*, long, long);
+
+    public :
+        WorkStealingDeque(long capacity = 256);
+        WorkStealingDeque(const WorkStealingDeque&) = delete;
+        WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+        // Owner only
+        void push(T);
+        bool take(T&);
+        // Any thread. May fail spuriously when racing with another steal
+        bool steal(T&);
+        // take & steal only write to their argument when they return true
+        bool empty() const {
+            return bottom.load(std::memory_order_relaxed) <=
+                   top.load(std::memory_order_relaxed);
+        }
+};
+
+template <typename T>
+WorkStealingDeque<T>::WorkStealingDeque(long capacity) {
+    long n = 1;
+    while (n < capacity)
+        n <<= 1;
+    arrays.emplace_back(new Array(n));
+    array.store(arrays.back().get(), std::memory_order_relaxed);
+}
+
+template <typename T>
+typename WorkStealingDeque<T>::Array*
+WorkStealingDeque<T>::grow(Array* a, long b, long t) {
+    Array* bigger = new Array(2 * a->size);
+    for (long i = t; i < b; ++i)
+        bigger->put(i, a->get(i));
+    arrays.emplace_back(bigger);
+    array.store(bigger, std::memory_order_release);
+    return bigger;
+}
+
+
+template <typename T>
+void WorkStealingDeque<T>::push(T x) {
+    long b = bottom.load(std::memory_order_relaxed);
+    long t = top.load(std::memory_order_acquire);
+    Array* a = array.load(std::memory_order_relaxed);
+    if (b - t > a->size - 1)
+        a = grow(a, b, t);
+    a->put(b, x);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+template <typename T>
+bool WorkStealingDeque<T>::take(T& x) {
+    long b = bottom.load(std::memory_order_relaxed) - 1;
+    Array* a = array.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    // Reserve the bottom element before looking at top, so that a thief
+    // and the owner can't both get the last element
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long t = top.load(std::memory_order_relaxed);
+    if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return false;   // Empty
+    }
+    T y = a->get(b);
+    if (t == b) {
+        // Last element, race the thieves for it. If one wins, it's theirs
+        bool won = top.compare_exchange_strong(t, t + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        if (!won)
+            return false;
+    }
+    x = y;
+    return true;
+}
+
+template <typename T>
+bool WorkStealingDeque<T>::steal(T& x) {
+    long t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long b = bottom.load(std::memory_order_acquire);
+    if (t >= b)
+        return false;   // Empty
+    Array* a = array.load(std::memory_order_acquire);
+    T y = a->get(t);
+    if (!top.compare_exchange_strong(t, t + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed))
+        return false;
+    x = y;
+    return true;
+}
+
+
+
+
+/*
+Minimal fork-join scheduler on work-stealing deques.
+
+Each worker thread owns a deque. Tasks spawned from a worker go onto its own
+deque, and a worker with nothing left steals from a random other one, so
+there is no shared queue or lock that every task goes through. The thread
+that creates the Scheduler becomes worker 0; tasks can only be spawned from
+it and from inside other tasks.
+
+Tasks are spawned into a TaskGroup, whose wait() returns once all of them
+have finished. Instead of blocking, a waiting thread keeps running tasks
+(its own first, then stolen ones), so nested fork-join recursion never ties
+up threads. Idle workers back off to sleeping after a while, and are woken
+when new tasks are spawned.
+
+If a task throws, the exception is caught on the thread that ran it, and the
+first one is rethrown by the group's wait() once all its tasks are done.
+The destructor also waits for the tasks, but drops such an exception. It
+must run on a thread that may wait (else the program is terminated, rather
+than throwing from a destructor).
+
+    Scheduler s;
+    TaskGroup g(s);
+    g.run([&] {left = sum(a, mid);});
+    right = sum(mid, b);
+    g.wait();
+*/
+class Scheduler;
+
+class TaskGroup {
+
+    Scheduler& sched;
+    std::atomic<int> pending {0};
+    std::mutex errorLock;
+    std::exception_ptr error;   // First exception thrown by a task
+    friend class Scheduler;
+
+    bool canWait() const;
+    void drain();
+    void fail(std::exception_ptr);
+
+    public :
+        TaskGroup(Scheduler& s) : sched(s) {}
+        ~TaskGroup();
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        template <typename F>
+        void run(F&& f);
+        void wait();
+};
+
+
+class Scheduler {
+
+    struct Task {
+        std::function<void()> f;
+        TaskGroup* group;
+    };
+    struct alignas(cacheLine) Worker {
+        WorkStealingDeque<Task*> deque;
+        unsigned rng;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stopping {false};
+
+    std::mutex idleLock;
+    std::condition_variable idle;
+    std::atomic<int> sleepers {0};
+
+    // Worker index of the calling thread in the scheduler it belongs to
+    static thread_local Scheduler* currentSched;
+    static thread_local int currentWorker;
+
+    void loop(int);
+    bool runOne(int);
+    void checkThread();
+    void spawn(Task*);
+    friend class TaskGroup;
+
+    public :
+        Scheduler(unsigned nthreads = std::thread::hardware_concurrency());
+        ~Scheduler();
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+        int size() const {return workers.size();}
+};
+
+inline thread_local Scheduler* Scheduler::currentSched = nullptr;
+inline thread_local int Scheduler::currentWorker = -1;
+
+
+Scheduler::Scheduler(unsigned nthreads) {
+    if (nthreads == 0)
+        nthreads = 1;
+    for (unsigned i = 0; i < nthreads; ++i) {
+        workers.emplace_back(new Worker());
+        workers.back()->rng = 2463534242u + 7919u * i;
+    }
+    currentSched = this;
+    currentWorker = 0;
+    for (unsigned i = 1; i < nthreads; ++i)
+        threads.emplace_back(&Scheduler::loop, this, int(i));
+}
+
+Scheduler::~Scheduler() {
+    stopping.store(true);
+    {
+        std::lock_guard<std::mutex> lock(idleLock);
+        idle.notify_all();
+    }
+    for (std::thread& t : threads)
+        t.join();
+    if (currentSched == this)
+        currentSched = nullptr;
+}
+
+
+void Scheduler::checkThread() {
+    if (currentSched != this)
+        throw std::logic_error("Tasks can only be spawned from the thread "
+                               "that created the Scheduler, or from tasks");
+}
+
+void Scheduler::spawn(Task* task) {
+    workers[currentWorker]->deque.push(task);
+    if (sleepers.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(idleLock);
+        idle.notify_one();
+    }
+}
+
+bool Scheduler::runOne(int w) {
+    // Runs one task, from the worker's own deque or else stolen from
+    // another one. False if no task was found
+    Task* task = nullptr;
+    if (!workers[w]->deque.take(task)) {
+        int n = workers.size();
+        unsigned& x = workers[w]->rng;
+        int start = (x ^= x << 13, x ^= x >> 17, x ^= x << 5) % n;
+        for (int i = 0; i < n && task == nullptr; ++i) {
+            int v = (start + i) % n;
+            if (v != w && !workers[v]->deque.steal(task))
+                task = nullptr;
+        }
+        if (task == nullptr)
+            return false;
+    }
+    try {
+        task->f();
+    } catch (...) {
+        task->group->fail(std::current_exception());
+    }
+    task->group->pending.fetch_sub(1, std::memory_order_release);
+    delete task;
+    return true;
+}
+
+void Scheduler::loop(int w) {
+    currentSched = this;
+    currentWorker = w;
+    int fails = 0;
+    while (!stopping.load(std::memory_order_relaxed)) {
+        if (runOne(w)) {
+            fails = 0;
+        } else if (++fails < 64) {
+            std::this_thread::yield();
+        } else {
+            // Sleep until woken by spawn (with a timeout, since a wakeup
+            // can be missed between the last failed steal & going to sleep)
+            std::unique_lock<std::mutex> lock(idleLock);
+            sleepers.fetch_add(1);
+            idle.wait_for(lock, std::chrono::milliseconds(1));
+            sleepers.fetch_sub(1);
+            fails = 0;
+        }
+    }
+}
+
+
+template <typename F>
+void TaskGroup::run(F&& f) {
+    sched.checkThread();
+    std::unique_ptr<Scheduler::Task> task(
+        new Scheduler::Task {std::forward<F>(f), this});
+    // Counted before the push, since a thief may run (& uncount) the task
+    // as soon as it's pushed. Uncounted again if the push fails
+    pending.fetch_add(1, std::memory_order_relaxed);
+    try {
+        sched.spawn(task.get());
+    } catch (...) {
+        pending.fetch_sub(1, std::memory_order_relaxed);
+        throw;
+    }
+    task.release();
+}
+
+bool TaskGroup::canWait() const {
+    return pending.load(std::memory_order_acquire) == 0 ||
+           Scheduler::currentSched == &sched;
+}
+
+void TaskGroup::drain() {
+    while (pending.load(std::memory_order_acquire) > 0) {
+        if (!sched.runOne(Scheduler::currentWorker))
+            std::this_thread::yield();
+    }
+}
+
+void TaskGroup::fail(std::exception_ptr e) {
+    std::lock_guard<std::mutex> lock(errorLock);
+    if (error == nullptr)
+        error = e;
+}
+
+void TaskGroup::wait() {
+    if (!canWait())
+        throw std::logic_error("Tasks can only be waited for from the thread "
+                               "that created the Scheduler, or from tasks");
+    drain();
+    std::exception_ptr e;
+    {
+        std::lock_guard<std::mutex> lock(errorLock);
+        std::swap(e, error);
+    }
+    if (e != nullptr)
+        std::rethrow_exception(e);
+}
+
+TaskGroup::~TaskGroup() {
+    if (!canWait()) {
+        std::fputs("TaskGroup destroyed with pending tasks on a thread that "
+                   "can't wait for them\n", stderr);
+        std::terminate();
+    }
+    drain();
+}
@@ -0,0 +1,86 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "sqll.hpp"
+
+/*
+Dumping & reloading a large Queue : print() and appending values read with
+operator>> one at a time, against serialize()/deserialize() in text and
+binary form (all in memory, so only the formatting & list building count).
+
+    ./serialize-bench [size]
+
+Compile with -O2 -DNDEBUG.
+*/
+
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+
+void report(const string& name, long n, size_t bytes, Clock::time_point t0) {
+    double s = chrono::duration<double>(Clock::now() - t0).count();
+    cout << left << setw(30) << name << right << fixed << setprecision(1)
+         << setw(10) << s * 1e9 / n << " ns/value" << setw(12) << bytes / 1e6
+         << " MB\n";
+}
+
+
+int main(int argc, char* argv[]) {
+    int n = (argc > 1) ? atoi(argv[1]) : 2000000;
+    mt19937 rng(3);
+    Queue<> q;
+    for (int i = 0; i < n; ++i)
+        q.enqueue(int(rng()) >> int(rng() % 31));
+    cout << "Queue of " << n << " ints\n\n";
+
+    string text, bin;
+    {
+        Clock::time_point t0 = Clock::now();
+        ostringstream os;
+        q.print(" ", "\n", os);
+        text = os.str();
+        report("print", n, text.size(), t0);
+    }
+    {
+        Clock::time_point t0 = Clock::now();
+        string s = q.serialize();
+        report("serialize (text)", n, s.size(), t0);
+        if (s != text) cout << "  DIFFERENT TEXT\n";
+    }
+    {
+        Clock::time_point t0 = Clock::now();
+        bin = q.serialize(true);
+        report("serialize (binary)", n, bin.size(), t0);
+    }
+    cout << '\n';
+    {
+        Clock::time_point t0 = Clock::now();
+        istringstream is(text);
+        Queue<> r;
+        int x;
+        while (is >> x)
+            r.enqueue(x);
+        report("operator>> + enqueue", n, text.size(), t0);
+    }
+    {
+        Clock::time_point t0 = Clock::now();
+        Queue<> r;
+        r.deserialize(text);
+        report("deserialize (text)", n, text.size(), t0);
+        if (r.size() != n) cout << "  WRONG SIZE\n";
+    }
+    {
+        Clock::time_point t0 = Clock::now();
+        Queue<> r;
+        r.deserialize(bin);
+        report("deserialize (binary)", n, bin.size(), t0);
+        if (r.size() != n) cout << "  WRONG SIZE\n";
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sqll.hpp"
+
+/*
+Sorting a LinkedList of random ints : copying it into a std::vector,
+std::sort & rebuilding the list, against sort() and parallelSort() relinking
+the nodes in place.
+
+    ./sort-bench [size] [threads]
+
+All the lists are built before sorting any, since nodes freed from a sorted
+list are reused in sorted (ie. scattered) order, which would slow down
+whichever case came next.
+
+Compile with -O2 -DNDEBUG -pthread.
+*/
+
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+
+LinkedList<> randomList(int n) {
+    mt19937 rng(8);
+    LinkedList<> l;
+    for (int i = 0; i < n; ++i)
+        l.append(int(rng()));
+    return l;
+}
+
+bool sorted(LinkedList<>& l) {
+    ListNode<>* n = l.startnode();
+    for (; n != nullptr && n->nxt() != nullptr; n = n->nxt())
+        if (n->nxt()->val < n->val)
+            return false;
+    return true;
+}
+
+void report(const string& name, LinkedList<>& l, Clock::time_point t0) {
+    double ms = chrono::duration<double, milli>(Clock::now() - t0).count();
+    cout << left << setw(30) << name << right << fixed << setprecision(1)
+         << setw(10) << ms << " ms" << (sorted(l) ? "" : "  NOT SORTED") << '\n';
+}
+
+
+int main(int argc, char* argv[]) {
+    int n = (argc > 1) ? atoi(argv[1]) : 2000000;
+    unsigned threads = (argc > 2) ? atoi(argv[2]) : max(4u, thread::hardware_concurrency());
+    cout << "LinkedList of " << n << " random ints\n\n";
+    vector<LinkedList<>> lists;
+    for (unsigned t = 1; t <= threads; t *= 2)
+        lists.push_back(randomList(n));
+    lists.push_back(randomList(n));
+    {
+        LinkedList<>& l = lists.back();
+        Clock::time_point t0 = Clock::now();
+        vector<int> v;
+        v.reserve(n);
+        for (ListNode<>* p = l.startnode(); p != nullptr; p = p->nxt())
+            v.push_back(p->val);
+        std::sort(v.begin(), v.end());
+        l.clear();
+        for (int x : v)
+            l.append(x);
+        report("vector + std::sort + rebuild", l, t0);
+    }
+    {
+        LinkedList<>& l = lists[0];
+        Clock::time_point t0 = Clock::now();
+        l.sort();
+        report("sort()", l, t0);
+    }
+    for (unsigned t = 2, i = 1; t <= threads; t *= 2, ++i) {
+        LinkedList<>& l = lists[i];
+        Clock::time_point t0 = Clock::now();
+        l.parallelSort(less<int>(), t);
+        report("parallelSort(), " + to_string(t) + " threads", l, t0);
+    }
+    return 0;
+}
@@ -1,45 +1,80 @@
+#pragma once
+
 
 #include <initializer_list>
 #include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory_resource>
 #include <stdexcept>
 #include <string>
 #include <iostream>
+#include <iterator>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 
 
+template <typename T> struct ListNode;
+template <typename T> class LinkedList;
+template <typename T, typename N = ListNode<T>> class NodePool;
+template <typename T> class IndexedList;
 
+template <typename T = int>
 struct ListNode {
 
     protected :
         ListNode* next = nullptr;
-    friend class LinkedList;
+    friend class LinkedList<T>;
+    friend class NodePool<T>;
+    friend class IndexedList<T>;
+
+        // A node whose value isn't constructed yet (only for the pool)
+        struct Uninit {};
+        ListNode(Uninit) {}
 
     public :
-        int val;
+        union {T val;};
         ListNode* nxt() const {return next;}
 
-        ListNode() = default;
-        ListNode(int x) : val(x) {}
-        ~ListNode() = default;
+        ListNode() : val() {}
+        ListNode(const T& x) : val(x) {}
+        ListNode(T&& x) : val(std::move(x)) {}
+        ~ListNode() {val.~T();}
 
-        ListNode& operator=(int i) {
-            val = i; return *this;
+        ListNode& operator=(const T& x) {
+            val = x; return *this;
         }
-        ListNode& operator=(ListNode&) = default;
-        ListNode& operator=(ListNode&&) = default;
-        
-        operator int() const {return val;}
+        ListNode& operator=(T&& x) {
+            val = std::move(x); return *this;
+        }
+        ListNode& operator=(const ListNode& n) {
+            val = n.val; return *this;
+        }
+
+        operator const T&() const {return val;}
+        operator T&() {return val;}
 };
-/* 
-Assigning an int to the node with operator= sets its value
-Copy & move using operator= use compiler-generated functions
+/*
+Assigning a value (or another node) to the node with operator= sets its value
 
-The node can be implicitly converted to its `int` value
+The node can be implicitly converted to (a reference to) its value
 
 This way, using operator[] on the linked list returns the node,
-which you can read/write as int (its value),
+which you can read/write as a T (its value),
 but also continue traversing the list using the same returned reference
 if necessary, by calling .nxt() on it.
 
+`val` is in a union only so that the pool can keep nodes around without a
+constructed value; for the user it's an ordinary member.
+
 Afterthought : This seems complicated and unnecessary now
 operator[] on the linked list should just directly return the node's value
 and some kind of iterator for traversal separately.
@@ -48,58 +83,470 @@ and some kind of iterator for traversal separately.
 
 
 
+/*
+All nodes of LinkedLists (and so of Stacks & Queues) are taken from a pool
+instead of calling `new`/`delete` for each one. Nodes are carved out of
+chunks of `chunksize` at a time, and free nodes are kept in a list threaded
+through their `next` pointers. So :
+- Most insertions just pop a node off the free list, and most deletions
+  push one back on, both O(1) with no call to the allocator.
+- Since a list's own nodes are already linked, clear() (and so the
+  destructor) hands back all of them at once in O(1), by attaching the
+  whole chain to the free list. (Values with a destructor still have to be
+  destroyed one by one first.)
+
+Each thread has its own pool (per element type), so no locking is needed
+for this. Memory only moves between threads in whole chains through a
+shared depot : a thread with too many free nodes (eg. the consumer of a
+queue, which only frees) donates half of them there, keeping the other half
+so that it doesn't take them straight back, and a thread that has run out
+takes a chain from there before allocating a new chunk. Chunks are
+never returned to the system, they are reused for the lifetime of the
+program.
+
+Free nodes hold no value : get() constructs it in place, and put() and
+putChain() expect it to be destroyed already.
+
+The pool of a thread is destroyed at its exit, which may be before some
+lists that still use it (eg. thread_local lists, or global ones on the main
+thread). After that, the thread's freed nodes are appended to one loose
+chain in the depot, and new ones are allocated one at a time.
+
+The pool is over ListNode<T> by default, N is another node type derived from
+it (like the DListNode of deque.hpp), which gets pools of its own.
+
+Define SQLL_NO_POOL to allocate every node separately with new/delete.
+*/
+template <typename T, typename N>
+class NodePool {
+
+    using Node = N;
+
+    static const int chunksize = 256;
+    static const long maxfree = 64 * chunksize;
+
+    Node* freelist = nullptr;
+    Node* freetail = nullptr;
+    long nfree = 0;
+
+    struct Chain {
+        Node *first, *last;
+        long n;
+        bool loose;     // Freed after their thread's pool, see putChain
+    };
+    struct Depot {
+        std::mutex m;
+        std::vector<Chain> chains;
+    };
+    // Deliberately never destroyed, so that nodes stay valid in lists
+    // destroyed after it would have been (eg. global variables)
+    static Depot& depot() {static Depot* d = new Depot; return *d;}
+
+    // The pool of the calling thread, unless destroyed() already
+    static NodePool& local() {thread_local NodePool p; return p;}
+    static bool& destroyed() {thread_local bool d = false; return d;}
+
+    NodePool() = default;
+    ~NodePool() {
+        donate(0);
+        destroyed() = true;
+    }
+
+    void carve(long);
+    void refill();
+    void donate(long);
+    template <typename... Args>
+    Node* pop(Args&&...);
+    void push(Node*, Node*, long);
+    static void toDepot(Node*, Node*, long, bool = false);
+
+    public :
+        NodePool(const NodePool&) = delete;
+        NodePool& operator=(const NodePool&) = delete;
+
+        // All through the calling thread's pool
+        template <typename... Args>
+        static Node* get(Args&&...);
+        static void put(Node* n) {putChain(n, n, 1);}
+        static void putChain(Node*, Node*, long);
+        // Makes sure the next n get()s won't need to allocate
+        static void reserve(long);
+};
+
+template <typename T, typename N>
+void NodePool<T, N>::carve(long count) {
+    // Adds `count` new nodes (one allocation) in front of the free list
+    Node* chunk = static_cast<Node*>(::operator new(count * sizeof(Node)));
+    for (long i = 0; i < count; ++i)
+        new (chunk + i) Node(typename Node::Uninit());
+    for (long i = 0; i < count - 1; ++i)
+        chunk[i].next = chunk + i + 1;
+    chunk[count - 1].next = freelist;
+    if (freelist == nullptr)
+        freetail = chunk + count - 1;
+    freelist = chunk;
+    nfree += count;
+}
+
+template <typename T, typename N>
+void NodePool<T, N>::refill() {
+    // Take a donated chain if there is one, else carve up a new chunk
+    {
+        std::lock_guard<std::mutex> lock(depot().m);
+        if (!depot().chains.empty()) {
+            Chain c = depot().chains.back();
+            depot().chains.pop_back();
+            freelist = c.first; freetail = c.last; nfree = c.n;
+            return;
+        }
+    }
+    carve(chunksize);
+}
+
+template <typename T, typename N>
+void NodePool<T, N>::donate(long keep) {
+    // Hands all but the first `keep` free nodes to the depot. Those are the
+    // most recently freed ones, likely still in the cache
+    if (nfree <= keep)
+        return;
+    Node* first = freelist;
+    Node* last = freetail;
+    if (keep == 0) {
+        freelist = freetail = nullptr;
+    } else {
+        Node* n = freelist;
+        for (long i = 1; i < keep; ++i)
+            n = static_cast<Node*>(n->next);
+        first = static_cast<Node*>(n->next);
+        n->next = nullptr;
+        freetail = n;
+    }
+    toDepot(first, last, nfree - keep);
+    nfree = keep;
+}
+
+template <typename T, typename N>
+void NodePool<T, N>::toDepot(Node* first, Node* last, long n, bool loose) {
+    std::lock_guard<std::mutex> lock(depot().m);
+    std::vector<Chain>& chains = depot().chains;
+    if (loose && !chains.empty() && chains.back().loose) {
+        // Freed one at a time, so gathered into one chain rather than
+        // leaving one tiny chain per node
+        chains.back().last->next = first;
+        chains.back().last = last;
+        chains.back().n += n;
+        return;
+    }
+    chains.push_back({first, last, n, loose});
+}
+
+template <typename T, typename N>
+template <typename... Args>
+N* NodePool<T, N>::get(Args&&... args) {
+    if (!destroyed())
+        return local().pop(std::forward<Args>(args)...);
+    // No pool left to take from
+    Node* n = static_cast<Node*>(::operator new(sizeof(Node)));
+    new (n) Node(typename Node::Uninit());
+    try {
+        new (&n->val) T(std::forward<Args>(args)...);
+    } catch (...) {
+        ::operator delete(n);
+        throw;
+    }
+    return n;
+}
+
+template <typename T, typename N>
+template <typename... Args>
+N* NodePool<T, N>::pop(Args&&... args) {
+    if (freelist == nullptr)
+        refill();
+    Node* n = freelist;
+    new (&n->val) T(std::forward<Args>(args)...);
+    freelist = static_cast<Node*>(n->next);
+    if (freelist == nullptr)
+        freetail = nullptr;
+    --nfree;
+    n->next = nullptr;
+    return n;
+}
+
+template <typename T, typename N>
+void NodePool<T, N>::putChain(Node* first, Node* last, long n) {
+    // `first` .. `last` must already be linked through `next`
+    if (!destroyed()) {
+        local().push(first, last, n);
+    } else {
+        last->next = nullptr;
+        toDepot(first, last, n, true);
+    }
+}
+
+template <typename T, typename N>
+void NodePool<T, N>::push(Node* first, Node* last, long n) {
+    last->next = freelist;
+    if (freelist == nullptr)
+        freetail = last;
+    freelist = first;
+    nfree += n;
+    if (nfree > maxfree)
+        donate(maxfree / 2);
+}
+
+template <typename T, typename N>
+void NodePool<T, N>::reserve(long n) {
+    if (destroyed())
+        return;
+    NodePool& p = local();
+    if (p.nfree >= n)
+        return;
+    // Rounded up to whole chunks, to keep allocations few even when this is
+    // called for small lists over & over
+    long need = n - p.nfree;
+    p.carve((need + chunksize - 1) / chunksize * chunksize);
+}
+
+
+
+/*
+LinkedList of any type T (int by default). Values can be copied or moved
+in (insert/append), or constructed in place from constructor arguments
+(emplace/emplace_back), and remove() moves the value out. Copying a list
+copies all its values; moving one just hands over its nodes.
+
+A list can also be given a std::pmr::memory_resource, which all its nodes
+are then allocated from instead of the pool (eg. a monotonic_buffer_resource
+for the lists used while handling one request, released all at once after).
+The resource must outlive the list. It goes along with the nodes : a list
+moved from (or split off) another uses the other's resource, while a copy
+uses the pool, and copy assignment keeps the list's own. Splicing lists with
+different resources moves the values into new nodes.
+*/
+template <typename T = int>
 class LinkedList {
 
     protected :
-        ListNode* start = nullptr;
-        ListNode* end = nullptr;
+        using Node = ListNode<T>;
+
+        Node* start = nullptr;
+        Node* end = nullptr;
         int l = 0;
+        std::pmr::memory_resource* res = nullptr;   // nullptr : the pool
+
+        template <typename... Args>
+        Node* newNode(Args&&...);
+        void freeNode(Node*);
+        void freeChain(Node*, Node*, int);
+        bool sameResource(const LinkedList&) const;
+        void adopt(LinkedList&);
+
+        void spliceFront(LinkedList&);
+        LinkedList takeFront(int);
+        int removeFront(T*, int);
+
+        struct Run {Node* first = nullptr; Node* last = nullptr;};
+        template <typename Compare>
+        static Run merge(Run, Run, Compare&);
+        template <typename Compare>
+        static Run sortChain(Node*, Compare&);
 
     public :
         LinkedList() = default;
-        LinkedList(const std::initializer_list<int>&);
-        ~LinkedList() {clear(); std::cerr<<"Bye\n";}
+        explicit LinkedList(std::pmr::memory_resource* r) : res(r) {}
+        LinkedList(const std::initializer_list<T>&,
+                   std::pmr::memory_resource* = nullptr);
+        LinkedList(const LinkedList&);
+        LinkedList(LinkedList&&) noexcept;
+        LinkedList& operator=(const LinkedList&);
+        LinkedList& operator=(LinkedList&&) noexcept;
+        ~LinkedList() {clear();}
 
         int size() {return l;}
-        ListNode* startnode() {return start;}
-        ListNode& operator[](int);
-        ListNode& insert(int, int);
-        ListNode& append(int);
-        int remove(int);
+        std::pmr::memory_resource* resource() const {return res;}
+        Node* startnode() {return start;}
+        Node& operator[](int);
+        template <typename... Args>
+        Node& emplace(int, Args&&...);
+        Node& insert(int i, const T& val) {return emplace(i, val);}
+        Node& insert(int i, T&& val) {return emplace(i, std::move(val));}
+        template <typename... Args>
+        Node& emplace_back(Args&&...);
+        Node& append(const T& val) {return emplace_back(val);}
+        Node& append(T&& val) {return emplace_back(std::move(val));}
+        T remove(int);
         void clear();
-        void print(const std::string&, const std::string&, std::ostream&);
+        void splice(LinkedList&);
+        void splice(LinkedList&& o) {splice(o);}
+        void spliceCopy(LinkedList&);
+        LinkedList splitAt(int);
+        template <typename Compare = std::less<T>>
+        void sort(Compare = Compare());
+        template <typename Compare = std::less<T>>
+        void parallelSort(Compare = Compare(),
+                          unsigned threads = std::thread::hardware_concurrency());
+        void print(const std::string& = " ", const std::string& = "\n",
+                   std::ostream& = std::cout);
+
+        std::string serialize(bool binary = false) const;
+        void serialize(std::ostream&, bool binary = false) const;
+        void deserialize(const char*, std::size_t);
+        void deserialize(const std::string& s) {deserialize(s.data(), s.size());}
+        void deserialize(std::istream&);
 };
 
-LinkedList::LinkedList(const std::initializer_list<int>& il) {
-    for (const int& x : il) {
-        ListNode* nn = new ListNode(x);
-        if (start == nullptr)
-            start = nn;
-        if (end != nullptr)
-            end->next = nn;
-        end = nn;
-        ++l;
+template <typename T>
+template <typename... Args>
+ListNode<T>* LinkedList<T>::newNode(Args&&... args) {
+    if (res != nullptr) {
+        Node* n = new (res->allocate(sizeof(Node), alignof(Node)))
+            Node(typename Node::Uninit());
+        try {
+            new (&n->val) T(std::forward<Args>(args)...);
+        } catch (...) {
+            res->deallocate(n, sizeof(Node), alignof(Node));
+            throw;
+        }
+        return n;
     }
+#ifdef SQLL_NO_POOL
+    Node* n = new Node(typename Node::Uninit());
+    try {
+        new (&n->val) T(std::forward<Args>(args)...);
+    } catch (...) {
+        ::operator delete(n);
+        throw;
+    }
+    return n;
+#else
+    return NodePool<T>::get(std::forward<Args>(args)...);
+#endif
 }
 
-ListNode& LinkedList::operator[](int i) {
+template <typename T>
+void LinkedList<T>::freeNode(Node* n) {
+    if (res != nullptr) {
+        n->val.~T();
+        res->deallocate(n, sizeof(Node), alignof(Node));
+        return;
+    }
+#ifdef SQLL_NO_POOL
+    delete n;
+#else
+    n->val.~T();
+    NodePool<T>::put(n);
+#endif
+}
+
+template <typename T>
+void LinkedList<T>::freeChain(Node* first, Node* last, int n) {
+    // Frees the n nodes `first` .. `last`, linked through `next` (and
+    // last->next must be nullptr)
+    if (res != nullptr) {
+        while (first != nullptr) {
+            Node* nx = first->next;
+            freeNode(first);
+            first = nx;
+        }
+        return;
+    }
+#ifdef SQLL_NO_POOL
+    (void)last; (void)n;
+    while (first != nullptr) {
+        Node* nx = first->next;
+        delete first;
+        first = nx;
+    }
+#else
+    if (!std::is_trivially_destructible<T>::value) {
+        for (Node* c = first; c != nullptr; c = c->next)
+            c->val.~T();
+    }
+    NodePool<T>::putChain(first, last, n);
+#endif
+}
+
+template <typename T>
+bool LinkedList<T>::sameResource(const LinkedList& o) const {
+    return res == o.res || (res != nullptr && o.res != nullptr && res->is_equal(*o.res));
+}
+
+template <typename T>
+void LinkedList<T>::adopt(LinkedList& o) {
+    // Makes o's nodes come from this list's resource, so that they can be
+    // relinked into it. O(N) if they don't already
+    if (sameResource(o))
+        return;
+    LinkedList moved(res);
+    for (Node* n = o.start; n != nullptr; n = n->next)
+        moved.emplace_back(std::move(n->val));
+    o = std::move(moved);
+}
+
+template <typename T>
+LinkedList<T>::LinkedList(const std::initializer_list<T>& il,
+                          std::pmr::memory_resource* r) : res(r) {
+    for (const T& x : il)
+        emplace_back(x);
+}
+
+template <typename T>
+LinkedList<T>::LinkedList(const LinkedList& o) {
+    for (Node* n = o.start; n != nullptr; n = n->next)
+        emplace_back(n->val);
+}
+
+template <typename T>
+LinkedList<T>::LinkedList(LinkedList&& o) noexcept
+    : start(o.start), end(o.end), l(o.l), res(o.res) {
+    o.start = o.end = nullptr;
+    o.l = 0;
+}
+
+template <typename T>
+LinkedList<T>& LinkedList<T>::operator=(const LinkedList& o) {
+    if (this != &o) {
+        LinkedList copy(res);
+        for (Node* n = o.start; n != nullptr; n = n->next)
+            copy.emplace_back(n->val);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+template <typename T>
+LinkedList<T>& LinkedList<T>::operator=(LinkedList&& o) noexcept {
+    if (this != &o) {
+        clear();
+        std::swap(start, o.start);
+        std::swap(end, o.end);
+        std::swap(l, o.l);
+        std::swap(res, o.res);
+    }
+    return *this;
+}
+
+template <typename T>
+ListNode<T>& LinkedList<T>::operator[](int i) {
     if (i<0 || i>=l) {
         throw std::out_of_range("Invalid index " + std::to_string(i) + \
         ". Extent is 0.." + std::to_string((l>0)?l-1:0));
     }
     int a=0;
-    ListNode* n = start;
+    Node* n = start;
     while (a++ < i)
         n = n->next;
     return *n;
 }
 
-ListNode& LinkedList::insert(int i, int val) {
+template <typename T>
+template <typename... Args>
+ListNode<T>& LinkedList<T>::emplace(int i, Args&&... args) {
     if (i<0 || i>l) {
         throw std::out_of_range("Invalid insertion index " + std::to_string(i) + \
         ". Extent is 0.." + std::to_string(l));
     }
-    ListNode* nn = new ListNode(val);
+    Node* nn = newNode(std::forward<Args>(args)...);
     if (i==0) {
         nn->next = start;
         start = nn;
@@ -111,7 +558,7 @@ ListNode& LinkedList::insert(int i, int val) {
         end = nn;
     } else {
         int a=0;
-        ListNode* n=start;
+        Node* n=start;
         while (a++ < i-1)
             n = n->next;
         nn->next = n->next;
@@ -121,8 +568,10 @@ ListNode& LinkedList::insert(int i, int val) {
     return *nn;
 }
 
-ListNode& LinkedList::append(int val) {
-    ListNode* nn = new ListNode(val);
+template <typename T>
+template <typename... Args>
+ListNode<T>& LinkedList<T>::emplace_back(Args&&... args) {
+    Node* nn = newNode(std::forward<Args>(args)...);
     nn->next = nullptr;
     if (l==0)
         start = nn;
@@ -133,58 +582,303 @@ ListNode& LinkedList::append(int val) {
     return *nn;
 }
 
-int LinkedList::remove(int i) {
+template <typename T>
+T LinkedList<T>::remove(int i) {
     if (i<0 || i>=l) {
         throw std::out_of_range("Invalid deletion index " + std::to_string(i) + \
         ". Extent is 0.." + std::to_string((l>0)?l-1:0));
     }
-    int val;
-    ListNode* temp;
+    Node* temp;
     if (i==0) {
-        val = start->val;
-        temp = start->next;
-        delete start;
-        start = temp;
+        temp = start;
+        start = start->next;
         if (l==1)
             end = nullptr;
     } else if (i==l-1) {
-        temp = start;
-        while (temp->next != end)
-            temp = temp->next;
-        temp->next = nullptr;
-        val = end->val;
-        delete end;
-        end = temp;
+        Node* n = start;
+        while (n->next != end)
+            n = n->next;
+        n->next = nullptr;
+        temp = end;
+        end = n;
     } else {
         int a=0;
-        ListNode* n=start;
+        Node* n=start;
         while (a++ < i-1)
             n = n->next;
         temp = n->next;
-        val = temp->val;
         n->next = temp->next;
-        delete temp;
     }
     --l;
+    T val = std::move(temp->val);
+    freeNode(temp);
     return val;
 }
 
-void LinkedList::clear() {
-    ListNode *c=start, *nx;
-    while (c != nullptr) {
-        nx = c->next;
-        delete c;
-        c = nx;
-        --l;
-    }
+template <typename T>
+void LinkedList<T>::clear() {
+    // The nodes are already chained, so they all go back at once
+    if (start != nullptr)
+        freeChain(start, end, l);
+    l = 0;
     start = nullptr;
     end = nullptr;
 }
 
-void LinkedList::print(const std::string& sep=" ", 
-                       const std::string& fin="\n", 
-                       std::ostream& stream = std::cout) {
-    ListNode* n = start;
+/*
+Moving nodes between lists : the nodes themselves are relinked, so nothing
+is allocated, freed or copied. (Nodes from any thread's pool can be freed
+into any other's, so lists built on different threads can be mixed too.)
+- splice(o) appends all of o to this list, and empties o, in O(1). Both
+  lists must use the same memory resource (see above), else it throws
+  std::invalid_argument. spliceCopy(o) does the same for any two lists, by
+  moving o's values into new nodes first when the resources differ (which
+  is O(N) & allocates)
+- splitAt(i) leaves the first i values in this list and returns the rest
+  as a new list, in O(i)
+*/
+template <typename T>
+void LinkedList<T>::splice(LinkedList& o) {
+    if (&o == this || o.start == nullptr)
+        return;
+    if (!sameResource(o))
+        throw std::invalid_argument("Splicing lists with different memory "
+                                    "resources, use spliceCopy");
+    if (start == nullptr)
+        start = o.start;
+    else
+        end->next = o.start;
+    end = o.end;
+    l += o.l;
+    o.start = o.end = nullptr;
+    o.l = 0;
+}
+
+template <typename T>
+void LinkedList<T>::spliceCopy(LinkedList& o) {
+    if (&o == this)
+        return;
+    adopt(o);
+    splice(o);
+}
+
+template <typename T>
+void LinkedList<T>::spliceFront(LinkedList& o) {
+    // Like splice, but puts o's values before this list's
+    if (&o == this || o.start == nullptr)
+        return;
+    if (!sameResource(o))
+        throw std::invalid_argument("Splicing lists with different memory "
+                                    "resources, use spliceCopy");
+    o.end->next = start;
+    if (start == nullptr)
+        end = o.end;
+    start = o.start;
+    l += o.l;
+    o.start = o.end = nullptr;
+    o.l = 0;
+}
+
+template <typename T>
+LinkedList<T> LinkedList<T>::splitAt(int i) {
+    if (i<0 || i>l) {
+        throw std::out_of_range("Invalid split index " + std::to_string(i) + \
+        ". Extent is 0.." + std::to_string(l));
+    }
+    LinkedList rest(res);
+    if (i == 0) {
+        rest.splice(*this);
+        return rest;
+    }
+    Node* n = start;
+    for (int a = 1; a < i; ++a)
+        n = n->next;
+    rest.start = n->next;
+    rest.end = (rest.start != nullptr) ? end : nullptr;
+    rest.l = l - i;
+    n->next = nullptr;
+    end = n;
+    l = i;
+    return rest;
+}
+
+template <typename T>
+LinkedList<T> LinkedList<T>::takeFront(int k) {
+    // Detaches (upto) the first k values as a new list, in O(k)
+    if (k >= l)
+        return splitAt(0);
+    LinkedList front(res);
+    if (k <= 0)
+        return front;
+    Node* n = start;
+    for (int a = 1; a < k; ++a)
+        n = n->next;
+    front.start = start;
+    front.end = n;
+    front.l = k;
+    start = n->next;
+    n->next = nullptr;
+    l -= k;
+    return front;
+}
+
+template <typename T>
+int LinkedList<T>::removeFront(T* out, int k) {
+    // Moves (upto) the first k values into out[], and frees their nodes all
+    // at once. Returns how many there were
+    if (k > l)
+        k = l;
+    if (k <= 0)
+        return 0;
+    Node* first = start;
+    Node* n = start;
+    out[0] = std::move(n->val);
+    for (int a = 1; a < k; ++a) {
+        n = n->next;
+        out[a] = std::move(n->val);
+    }
+    start = n->next;
+    if (start == nullptr)
+        end = nullptr;
+    l -= k;
+    n->next = nullptr;
+    freeChain(first, n, k);
+    return k;
+}
+
+/*
+Sorting relinks the existing nodes, so nothing is allocated or copied
+(values are never moved at all). It's a stable bottom-up merge sort, like a
+binary counter : bin[i] holds a sorted run of 2^i nodes (or nothing), and
+each next node is merged into bin[0], carrying upwards while the bins are
+full. Runs are only ever merged with the one of equal length, so that's
+O(N log N) comparisons, with no recursion & just 64 runs of extra space.
+Runs know their last node, so the new end of the list comes out of the
+last merge instead of another walk over it.
+
+parallelSort cuts the list into one sublist per thread, sorts those at the
+same time, and merges the sorted sublists pairwise (also in parallel, until
+the last merge). Below a few thousand nodes per thread it isn't worth
+starting threads, so it just sorts serially.
+
+`comp` is a strict weak ordering like for std::sort, and must not throw.
+*/
+template <typename T>
+template <typename Compare>
+typename LinkedList<T>::Run LinkedList<T>::merge(Run a, Run b, Compare& comp) {
+    // Merges two sorted nullptr terminated runs. On ties, a comes first
+    Run merged;
+    Node** tail = &merged.first;
+    while (a.first != nullptr && b.first != nullptr) {
+        if (comp(b.first->val, a.first->val)) {
+            *tail = merged.last = b.first;
+            b.first = b.first->next;
+        } else {
+            *tail = merged.last = a.first;
+            a.first = a.first->next;
+        }
+        tail = &(*tail)->next;
+    }
+    if (a.first != nullptr) {
+        *tail = a.first;
+        merged.last = a.last;
+    } else if (b.first != nullptr) {
+        *tail = b.first;
+        merged.last = b.last;
+    } else {
+        *tail = nullptr;
+    }
+    return merged;
+}
+
+template <typename T>
+template <typename Compare>
+typename LinkedList<T>::Run LinkedList<T>::sortChain(Node* n, Compare& comp) {
+    Run bin[64] = {};
+    while (n != nullptr) {
+        Run carry {n, n};
+        n = n->next;
+        carry.first->next = nullptr;
+        int i = 0;
+        for (; bin[i].first != nullptr; ++i) {
+            carry = merge(bin[i], carry, comp);     // bin[i] holds older nodes
+            bin[i] = Run();
+        }
+        bin[i] = carry;
+    }
+    Run sorted;
+    for (const Run& run : bin) {
+        if (run.first != nullptr)
+            sorted = merge(run, sorted, comp);
+    }
+    return sorted;
+}
+
+template <typename T>
+template <typename Compare>
+void LinkedList<T>::sort(Compare comp) {
+    if (l < 2)
+        return;
+    Run sorted = sortChain(start, comp);
+    start = sorted.first;
+    end = sorted.last;
+}
+
+template <typename T>
+template <typename Compare>
+void LinkedList<T>::parallelSort(Compare comp, unsigned threads) {
+    const int minPerThread = 1 << 13;
+    threads = std::max(1u, std::min(threads, unsigned(l / minPerThread)));
+    if (threads == 1) {
+        sort(comp);
+        return;
+    }
+
+    // Cut into equal parts, and sort each on its own thread
+    std::vector<Run> parts(threads);
+    Node* n = start;
+    for (int t = 0; t < int(threads); ++t) {
+        Node* first = n;
+        int len = l / int(threads) + (t < l % int(threads));
+        for (int a = 1; a < len; ++a)
+            n = n->next;
+        parts[t] = {first, n};
+        Node* nx = n->next;
+        n->next = nullptr;
+        n = nx;
+    }
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t)
+        pool.emplace_back([&parts, &comp, t] {
+            Compare c = comp;
+            parts[t] = sortChain(parts[t].first, c);
+        });
+    parts[0] = sortChain(parts[0].first, comp);
+    for (std::thread& th : pool)
+        th.join();
+
+    // Merge neighbouring parts (so that it stays stable), halving their
+    // number every round
+    for (std::size_t width = 1; width < parts.size(); width *= 2) {
+        pool.clear();
+        for (std::size_t i = 2 * width; i < parts.size(); i += 2 * width)
+            if (i + width < parts.size())
+                pool.emplace_back([&parts, &comp, i, width] {
+                    Compare c = comp;
+                    parts[i] = merge(parts[i], parts[i + width], c);
+                });
+        parts[0] = merge(parts[0], parts[width], comp);
+        for (std::thread& th : pool)
+            th.join();
+    }
+    start = parts[0].first;
+    end = parts[0].last;
+}
+
+template <typename T>
+void LinkedList<T>::print(const std::string& sep, const std::string& fin,
+                          std::ostream& stream) {
+    Node* n = start;
     while (n != nullptr) {
         stream << n->val;
         if (n != end)
@@ -196,28 +890,246 @@ void LinkedList::print(const std::string& sep=" ",
 
 
 
+/*
+Bulk serialization, for dumping & reloading whole lists quickly.
+
+The text form is what print() writes by default : the values separated by
+spaces, and a newline at the end. Values are formatted with std::to_chars
+straight into one buffer, which is written out at once, rather than going
+through operator<< for every value & separator. T must be an arithmetic
+type for this. Any whitespace separates values when reading.
+
+The binary form is the 4 bytes "SQL1", sizeof(T) & the number of values
+(as a uint32 & a uint64), and then the values' bytes as they are in memory.
+T must be trivially copyable for this, and it can only be read back on a
+machine of the same byte order.
+
+deserialize() tells both forms apart by the header, and replaces the list's
+contents. The new chain of nodes is built in one pass, with the nodes
+reserved from the pool up front. If the input is malformed, it throws
+std::invalid_argument and leaves the list as it was.
+*/
+namespace sqll_detail {
+    const char binaryMagic[4] = {'S', 'Q', 'L', '1'};
+    const std::size_t binaryHeader = 16;
+}
+
+template <typename T>
+std::string LinkedList<T>::serialize(bool binary) const {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Serialization needs a trivially copyable T");
+    std::string out;
+    if (binary) {
+        std::uint32_t size = sizeof(T);
+        std::uint64_t count = l;
+        out.resize(sqll_detail::binaryHeader + count * sizeof(T));
+        char* p = &out[0];
+        std::memcpy(p, sqll_detail::binaryMagic, 4);
+        std::memcpy(p + 4, &size, 4);
+        std::memcpy(p + 8, &count, 8);
+        p += sqll_detail::binaryHeader;
+        for (Node* n = start; n != nullptr; n = n->next, p += sizeof(T))
+            std::memcpy(p, &n->val, sizeof(T));
+        return out;
+    }
+
+    if constexpr (std::is_arithmetic<T>::value && !std::is_same<T, bool>::value) {
+        // Longest a value can get, with its sign (& exponent) and separator
+        const std::size_t width = std::is_integral<T>::value ?
+            std::numeric_limits<T>::digits10 + 3 :
+            std::numeric_limits<T>::max_digits10 + 12;
+        out.resize(std::size_t(l) * width + 1);
+        char* p = &out[0];
+        char* e = p + out.size();
+        for (Node* n = start; n != nullptr; n = n->next) {
+            p = std::to_chars(p, e, n->val).ptr;
+            *p++ = ' ';
+        }
+        if (l > 0)
+            --p;
+        *p++ = '\n';
+        out.resize(p - out.data());
+        return out;
+    } else {
+        throw std::logic_error("Text serialization needs an arithmetic type");
+    }
+}
+
+template <typename T>
+void LinkedList<T>::serialize(std::ostream& stream, bool binary) const {
+    std::string out = serialize(binary);
+    stream.write(out.data(), out.size());
+}
+
+template <typename T>
+void LinkedList<T>::deserialize(const char* data, std::size_t size) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Serialization needs a trivially copyable T");
+    LinkedList loaded(res);
+    auto link = [&](Node* nn) {
+        if (loaded.start == nullptr)
+            loaded.start = nn;
+        else
+            loaded.end->next = nn;
+        loaded.end = nn;
+        ++loaded.l;
+    };
+
+    if (size >= 4 && std::memcmp(data, sqll_detail::binaryMagic, 4) == 0) {
+        std::uint32_t width;
+        std::uint64_t count;
+        if (size < sqll_detail::binaryHeader)
+            throw std::invalid_argument("Truncated binary list header");
+        std::memcpy(&width, data + 4, 4);
+        std::memcpy(&count, data + 8, 8);
+        if (width != sizeof(T))
+            throw std::invalid_argument("Binary list of values of " +
+                std::to_string(width) + " bytes, expected " +
+                std::to_string(sizeof(T)));
+        if ((size - sqll_detail::binaryHeader) / sizeof(T) < count ||
+            count > std::uint64_t(std::numeric_limits<int>::max()))
+            throw std::invalid_argument("Truncated binary list of " +
+                                        std::to_string(count) + " values");
+#ifndef SQLL_NO_POOL
+        if (res == nullptr)
+            NodePool<T>::reserve(count);
+#endif
+        const char* p = data + sqll_detail::binaryHeader;
+        for (std::uint64_t i = 0; i < count; ++i, p += sizeof(T)) {
+            T val;
+            std::memcpy(&val, p, sizeof(T));
+            link(newNode(val));
+        }
+    } else if constexpr (std::is_arithmetic<T>::value &&
+                         !std::is_same<T, bool>::value) {
+        auto space = [](char c) {
+            return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+        };
+        const char* e = data + size;
+        // Count the values first, to reserve the nodes
+        long count = 0;
+        for (const char* p = data; p < e; ++p)
+            count += !space(*p) && (p == data || space(p[-1]));
+#ifndef SQLL_NO_POOL
+        if (res == nullptr)
+            NodePool<T>::reserve(count);
+#endif
+        const char* p = data;
+        while (true) {
+            while (p < e && space(*p))
+                ++p;
+            if (p == e)
+                break;
+            T val;
+            std::from_chars_result r = std::from_chars(p, e, val);
+            if (r.ec != std::errc() || (r.ptr < e && !space(*r.ptr)))
+                throw std::invalid_argument("Invalid value at offset " +
+                                            std::to_string(p - data));
+            link(newNode(val));
+            p = r.ptr;
+        }
+    } else {
+        throw std::invalid_argument("Not a binary list, and text lists need "
+                                    "an arithmetic type");
+    }
+    *this = std::move(loaded);
+}
+
+template <typename T>
+void LinkedList<T>::deserialize(std::istream& stream) {
+    // A binary list is read upto its end, text upto the end of the stream
+    std::string data(4, '\0');
+    stream.read(&data[0], 4);
+    data.resize(stream.gcount());
+    if (data.size() == 4 && std::memcmp(data.data(), sqll_detail::binaryMagic, 4) == 0) {
+        data.resize(sqll_detail::binaryHeader);
+        stream.read(&data[4], sqll_detail::binaryHeader - 4);
+        data.resize(4 + stream.gcount());
+        std::uint32_t width = 0;
+        std::uint64_t count = 0;
+        if (data.size() == sqll_detail::binaryHeader) {
+            std::memcpy(&width, data.data() + 4, 4);
+            std::memcpy(&count, data.data() + 8, 8);
+        }
+        // The values are read in chunks, so that a corrupt count can't make
+        // us allocate more than the stream actually holds. Bad headers are
+        // left for deserialize() to reject
+        if (width == sizeof(T) && count <= std::uint64_t(std::numeric_limits<int>::max())) {
+            std::uint64_t left = count * sizeof(T);
+            char chunk[1 << 16];
+            while (left > 0) {
+                stream.read(chunk, std::streamsize(std::min<std::uint64_t>(left, sizeof chunk)));
+                if (stream.gcount() == 0)
+                    break;
+                data.append(chunk, stream.gcount());
+                left -= stream.gcount();
+            }
+        }
+    } else {
+        data.append(std::istreambuf_iterator<char>(stream),
+                    std::istreambuf_iterator<char>());
+    }
+    deserialize(data.data(), data.size());
+}
+
+
+
 /* Stack and Queue, based on the Linkedlist */
 
-class Stack : private LinkedList {
-    
+template <typename T = int>
+class Stack : private LinkedList<T> {
+
+    using Base = LinkedList<T>;
+
     public :
-        using LinkedList::LinkedList;
-        using LinkedList::size;
-        using LinkedList::print;
-        using LinkedList::clear;
+        using Base::Base;
+        using Base::size;
+        using Base::print;
+        using Base::clear;
+        using Base::serialize;
+        using Base::deserialize;
 
-        ListNode& push(int val) {
-            return insert(0, val);
+        ListNode<T>& push(const T& val) {
+            return Base::emplace(0, val);
+        }
+        ListNode<T>& push(T&& val) {
+            return Base::emplace(0, std::move(val));
         }
-        int pop() {
-            if (l>0)
-                return remove(0);
+        template <typename... Args>
+        ListNode<T>& emplace(Args&&... args) {
+            return Base::emplace(0, std::forward<Args>(args)...);
+        }
+        T pop() {
+            if (this->l>0)
+                return this->remove(0);
             else
                 throw std::out_of_range("Stack is empty");
         }
-        ListNode& top() {
-            if (start != nullptr)
-                return *start;
+        // Pops (upto) k values at once : as a Stack with the same top, or
+        // moved into out[] top first (returns how many)
+        Stack pop_n(int k) {
+            Stack top;
+            static_cast<Base&>(top) = this->takeFront(k);
+            return top;
+        }
+        int pop_n(T* out, int k) {
+            return this->removeFront(out, k);
+        }
+        // Pushes all of o on top of this stack (in the same order), and
+        // empties it, in O(1). Like LinkedList::splice, both must use the
+        // same memory resource, or spliceCopy moves o's values over in O(N)
+        void splice(Stack& o) {
+            this->spliceFront(o);
+        }
+        void spliceCopy(Stack& o) {
+            if (&o != this) {
+                this->adopt(o);
+                this->spliceFront(o);
+            }
+        }
+        ListNode<T>& top() {
+            if (this->start != nullptr)
+                return *this->start;
             else
                 throw std::out_of_range("Stack is empty");
         }
@@ -225,32 +1137,63 @@ class Stack : private LinkedList {
 
 
 
-class Queue : private LinkedList {
-    
+template <typename T = int>
+class Queue : private LinkedList<T> {
+
+    using Base = LinkedList<T>;
+
     public :
-        using LinkedList::LinkedList;
-        using LinkedList::size;
-        using LinkedList::print;
-        using LinkedList::clear;
+        using Base::Base;
+        using Base::size;
+        using Base::print;
+        using Base::clear;
+        using Base::serialize;
+        using Base::deserialize;
 
-        ListNode& enqueue(int val) {
-            return append(val);
+        ListNode<T>& enqueue(const T& val) {
+            return this->emplace_back(val);
+        }
+        ListNode<T>& enqueue(T&& val) {
+            return this->emplace_back(std::move(val));
         }
-        int dequeue() {
-            if (l>0)
-                return remove(0);
+        template <typename... Args>
+        ListNode<T>& emplace(Args&&... args) {
+            return this->emplace_back(std::forward<Args>(args)...);
+        }
+        T dequeue() {
+            if (this->l>0)
+                return this->remove(0);
             else
                 throw std::out_of_range("Queue is empty");
         }
-        ListNode& front() {
-            if (start != nullptr)
-                return *start;
+        // Dequeues (upto) k values at once : as a Queue in the same order,
+        // or moved into out[] (returns how many)
+        Queue dequeue_n(int k) {
+            Queue front;
+            static_cast<Base&>(front) = this->takeFront(k);
+            return front;
+        }
+        int dequeue_n(T* out, int k) {
+            return this->removeFront(out, k);
+        }
+        // Enqueues all of o, and empties it, in O(1). Like
+        // LinkedList::splice, both must use the same memory resource, or
+        // spliceCopy moves o's values over in O(N)
+        void splice(Queue& o) {
+            Base::splice(o);
+        }
+        void spliceCopy(Queue& o) {
+            Base::spliceCopy(o);
+        }
+        ListNode<T>& front() {
+            if (this->start != nullptr)
+                return *this->start;
             else
                 throw std::out_of_range("Queue is empty");
         }
-        ListNode& back() {
-            if (end != nullptr) 
-                return *end;
+        ListNode<T>& back() {
+            if (this->end != nullptr)
+                return *this->end;
             else
                 throw std::out_of_range("Queue is empty");
         }
@@ -1,8 +1,23 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <iostream>
 #include <exception>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 
 #include "sqll.hpp"
+#include "concurrent.hpp"
+#include "scheduler.hpp"
+#include "indexed.hpp"
+#include "blocks.hpp"
+#include "blocking.hpp"
+#include "deque.hpp"
 
 
 using namespace std;
@@ -54,12 +69,475 @@ void test_list() {
     }
 }
 
+void test_thread_exit() {
+    // The lists are constructed before the thread's pool (empty lists don't
+    // touch it), so they're destroyed after it, and free into the depot
+    std::thread([] {
+        thread_local LinkedList<> l;
+        // Node by node, too
+        thread_local struct Drain {
+            Stack<> s;
+            ~Drain() {
+                while (s.size() > 0)
+                    s.pop();
+            }
+        } drain;
+        for (int i = 0; i < 1000; ++i) {
+            l.append(i);
+            drain.s.push(i);
+        }
+        thread_local Deque<> d {1, 2, 3};
+    }).join();
+    LinkedList<> l {1, 2};
+    l.print();
+}
+
+void test_spsc() {
+    // Capacity 5 is rounded up to 8. Fill it, then wrap around the ring
+    SPSCQueue<> q(5);
+    int n = 0;
+    while (q.try_enqueue(n))
+        ++n;
+    cout << n << " fit in " << q.capacity() << "\n";
+    try {
+        q.enqueue(8);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+    }
+    int buf[8];
+    cout << q.dequeue_n(buf, 5) << " dequeued, ";
+    int more[] {8, 9, 10, 11, 12, 13, 14};
+    cout << q.enqueue_n(more, 7) << " enqueued\n";
+    cout << q.front() << " .. " << q.back() << ", " << q.size() << " values\n";
+    n = q.dequeue_n(buf, 8);
+    for (int i = 0; i < n; ++i)
+        cout << buf[i] << ' ';
+    cout << "\n";
+    try {
+        q.dequeue();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+    }
+
+    // One producer & one consumer through a small ring : all values arrive,
+    // in order
+    const int count = 100000;
+    SPSCQueue<> r(64);
+    std::thread producer([&] {
+        for (int i = 0; i < count; ++i)
+            while (!r.try_enqueue(i))
+                std::this_thread::yield();
+    });
+    int expected = 0, wrong = 0, v;
+    while (expected < count) {
+        if (r.try_dequeue(v))
+            wrong += (v != expected++);
+        else
+            std::this_thread::yield();
+    }
+    producer.join();
+    cout << "out of order : " << wrong << "\n";
+}
+
+void test_concurrent_queue() {
+    ConcurrentQueue<> q;
+    for (int i = 1; i <= 3; ++i)
+        q.enqueue(i);
+    cout << q.dequeue() << " " << q.dequeue() << ", " << q.size() << " left\n";
+    int v;
+    cout << q.try_dequeue(v) << " " << v << " " << q.try_dequeue(v) << "\n";
+    try {
+        q.dequeue();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+    }
+
+    // 4 producers & 4 consumers : every value comes out exactly once, and
+    // each producer's values in the order they went in
+    const int producers = 4, per = 20000;
+    vector<atomic<int>> seen(producers * per);
+    vector<std::thread> threads;
+    atomic<int> taken {0}, reordered {0};
+    for (int p = 0; p < producers; ++p)
+        threads.emplace_back([&, p] {
+            for (int i = 0; i < per; ++i)
+                q.enqueue(p * per + i);
+        });
+    for (int c = 0; c < 4; ++c)
+        threads.emplace_back([&] {
+            vector<int> last(producers, -1);
+            int x;
+            while (taken.load() < producers * per) {
+                if (!q.try_dequeue(x)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                ++taken;
+                ++seen[x];
+                reordered += (x % per <= last[x / per]);
+                last[x / per] = x % per;
+            }
+        });
+    for (std::thread& t : threads)
+        t.join();
+    int wrong = 0;
+    for (atomic<int>& s : seen)
+        wrong += (s.load() != 1);
+    cout << "not dequeued exactly once : " << wrong << ", out of order : "
+         << reordered.load() << "\n";
+}
+
+void test_concurrent_stack() {
+    ConcurrentStack<> s;
+    for (int i = 1; i <= 3; ++i)
+        s.push(i);
+    cout << s.pop() << " " << s.pop() << ", " << s.size() << " left\n";
+    int v;
+    cout << s.try_pop(v) << " " << v << " " << s.try_pop(v) << "\n";
+    try {
+        s.pop();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+    }
+
+    // Threads pushing & popping at once (so also through the elimination
+    // array) : every value pushed is popped exactly once
+    const int threads = 4, per = 20000;
+    vector<atomic<int>> seen(threads * per);
+    vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t)
+        pool.emplace_back([&, t] {
+            int x;
+            for (int i = 0; i < per; ++i) {
+                s.push(t * per + i);
+                if (s.try_pop(x))
+                    ++seen[x];
+            }
+        });
+    for (std::thread& t : pool)
+        t.join();
+    while (s.try_pop(v))
+        ++seen[v];
+    int wrong = 0;
+    for (atomic<int>& x : seen)
+        wrong += (x.load() != 1);
+    cout << "not popped exactly once : " << wrong << "\n";
+}
+
+void test_scheduler() {
+    // Lots of one task groups, so the owner's take races the thieves for the
+    // last task all the time. Every task must run exactly once
+    Scheduler sched(4);
+    const int groups = 20000;
+    vector<atomic<int>> runs(2 * groups);
+    for (int i = 0; i < groups; ++i) {
+        TaskGroup g(sched);
+        g.run([&, i] {
+            ++runs[i];
+            // And from the workers too
+            TaskGroup inner(sched);
+            inner.run([&, i] {++runs[groups + i];});
+            inner.wait();
+        });
+        g.wait();
+    }
+    int wrong = 0;
+    for (atomic<int>& r : runs)
+        wrong += (r.load() != 1);
+    cout << "tasks not run exactly once : " << wrong << "\n";
+
+    // The first exception thrown by a task comes out of wait()
+    TaskGroup g(sched);
+    atomic<int> done {0};
+    for (int i = 0; i < 100; ++i)
+        g.run([&, i] {
+            ++done;
+            if (i == 50)
+                throw std::runtime_error("Task 50 failed");
+        });
+    try {
+        g.wait();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+    }
+    cout << done.load() << " tasks ran\n";
+}
+
+void test_indexed() {
+    IndexedList<> il;
+    il.insert(0, 2);
+    il.insert(il.size(), 3);
+    il.insert(0, 1);
+    il.insert(il.size(), 4);
+    il.print();
+    cout << il[0] << " " << il[il.size() - 1] << "\n";
+    try {
+        il.insert(il.size() + 1, 5);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+    }
+    try {
+        il[il.size()];
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+    }
+    cout << il.remove(0) << " " << il.remove(il.size() - 1) << "\n";
+    il.print();
+
+    // Enough inserts & removes at both ends & in between to build several
+    // levels, checked against a vector at every index
+    vector<int> v {2, 3};
+    unsigned x = 12345;
+    for (int i = 0; i < 5000; ++i) {
+        x = x * 1103515245 + 12345;
+        int at = (x >> 8) % 3 == 0 ? 0 : (x >> 8) % 3 == 1 ? int(v.size())
+                                       : int((x >> 12) % (v.size() + 1));
+        if ((x >> 20) % 4 == 0 && !v.empty()) {
+            at = std::min(at, int(v.size()) - 1);
+            il.remove(at);
+            v.erase(v.begin() + at);
+        } else {
+            il.insert(at, i);
+            v.insert(v.begin() + at, i);
+        }
+    }
+    int wrong = (il.size() != int(v.size()));
+    for (int i = 0; i < int(v.size()); ++i)
+        wrong += (il[i].val != v[i]);
+    cout << il.size() << " values, " << wrong << " wrong\n";
+}
+
+void test_serialize() {
+    LinkedList<> l {3, -1, 4, 1, -5};
+    for (bool binary : {false, true}) {
+        LinkedList<> back;
+        back.deserialize(l.serialize(binary));
+        back.print();
+        // Empty lists too
+        LinkedList<> empty {7};
+        empty.deserialize(LinkedList<>().serialize(binary));
+        cout << empty.size() << " ";
+        // Through a stream
+        std::stringstream ss;
+        l.serialize(ss, binary);
+        Queue<> q;
+        q.deserialize(ss);
+        q.print();
+    }
+    cout << LinkedList<>().serialize();
+    LinkedList<double> d {0.1, -2.5e-300, 1e300};
+    LinkedList<double> d2;
+    d2.deserialize(d.serialize());
+    cout << (d2[0] == 0.1 && d2[1] == -2.5e-300 && d2[2] == 1e300) << "\n";
+
+    // Malformed input throws, and leaves the list as it was
+    std::string bin = l.serialize(true);
+    const std::string bad[] {"1 2 x 4", "1 2-3", "99999999999",
+                             bin.substr(0, 10), bin.substr(0, bin.size() - 1),
+                             LinkedList<long long> {1}.serialize(true)};
+    for (const std::string& s : bad) {
+        try {
+            l.deserialize(s);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << '\n';
+        }
+    }
+    // Also from streams, where a corrupt count claiming ~2G values must not
+    // be allocated for up front
+    std::string huge = bin.substr(0, 20);
+    huge[8] = huge[9] = huge[10] = '\xff';
+    huge[11] = '\x7f';
+    std::string wide = huge;
+    wide[4] = 8;
+    for (const std::string& s : {huge, wide, bin.substr(0, 10), bin.substr(0, 30)}) {
+        std::istringstream in(s);
+        try {
+            l.deserialize(in);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << '\n';
+        }
+    }
+    l.print();
+}
+
+void test_sort() {
+    LinkedList<> l;
+    l.sort();
+    l.parallelSort();
+    cout << l.size() << " ";
+    l.append(1);
+    l.sort();
+    l.print();
+
+    // Sorting on the tens only : equal keys must keep their order
+    auto tens = [](int a, int b) {return a / 10 < b / 10;};
+    LinkedList<> s {31, 12, 35, 10, 33, 17, 30, 11};
+    s.sort(tens);
+    s.print();
+    s.sort(std::greater<int>());
+    s.append(0);        // after the new last node
+    s.print();
+
+    // Long enough to use several threads, with many equal keys
+    LinkedList<> big, par;
+    vector<int> v;
+    unsigned x = 777;
+    for (int i = 0; i < 100000; ++i) {
+        x = x * 1103515245 + 12345;
+        int k = (x >> 8) % 1000 * 1000 + i % 1000;
+        big.append(k);
+        par.append(k);
+        v.push_back(k);
+    }
+    auto thousands = [](int a, int b) {return a / 1000 < b / 1000;};
+    std::stable_sort(v.begin(), v.end(), thousands);
+    big.sort(thousands);
+    par.parallelSort(thousands, 4);
+    big.append(-1);
+    par.append(-1);
+    v.push_back(-1);
+    int wrong = 0, i = 0;
+    for (ListNode<>* a = big.startnode(), *b = par.startnode(); a != nullptr;
+         a = a->nxt(), b = b->nxt(), ++i)
+        wrong += (a->val != v[i]) + (b->val != v[i]);
+    wrong += (i != int(v.size()));
+    cout << wrong << " out of place\n";
+}
+
+void test_blocks() {
+    // 128 ints per block. Values go in & out in runs that cross the block
+    // boundaries at different offsets, so head & tail wrap into new blocks
+    BlockQueue<> q;
+    int in = 0, out = 0, wrong = 0;
+    for (int run = 1; run <= 20; ++run) {
+        for (int i = 0; i < run * 37; ++i)
+            q.enqueue(in++);
+        wrong += (q.back() != in - 1);
+        for (int i = 0; i < run * 29; ++i) {
+            wrong += (q.front() != out);
+            wrong += (q.dequeue() != out++);
+        }
+    }
+    cout << q.size() << " left (" << in - out << "), " << wrong << " wrong\n";
+    // A copy of a queue whose head is in the middle of a block
+    BlockQueue<> copy(q);
+    while (copy.size() > 0)
+        wrong += (copy.dequeue() != out++);
+    cout << wrong << " wrong in the copy\n";
+    q.clear();
+    try {
+        q.dequeue();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+    }
+
+    // Up & down across a boundary, with values that have a destructor
+    BlockStack<std::string> s;
+    for (int i = 0; i < 40; ++i)
+        s.push(std::string(20, char('a' + i % 26)));
+    for (int rep = 0; rep < 3; ++rep) {
+        for (int i = 0; i < 10; ++i)
+            s.pop();
+        for (int i = 30; i < 40; ++i)
+            s.push(std::string(20, char('a' + i % 26)));
+    }
+    cout << s.size() << " " << s.top() << "\n";
+}
+
+void test_blocking() {
+    // A long linger, so that sleepers can only be woken by a signal
+    const std::chrono::seconds linger(10);
+    BlockingQueue<> q(4, 16, linger);
+    q.enqueue(1);
+    q.enqueue(2);
+    int v = 0;
+    cout << q.dequeue() << " ";
+    cout << q.try_dequeue(v) << " " << v << " ";
+    cout << q.try_dequeue(v) << " ";
+    cout << q.try_dequeue_for(v, std::chrono::milliseconds(1)) << "\n";
+
+    // close() wakes every consumer blocked on the empty queue
+    auto t0 = std::chrono::steady_clock::now();
+    atomic<int> woken {0};
+    vector<std::thread> consumers;
+    for (int c = 0; c < 3; ++c)
+        consumers.emplace_back([&, c] {
+            if (c == 0) {
+                int buf[4];
+                while (q.dequeue_n(buf, 4) > 0) {}
+                ++woken;
+                return;
+            }
+            try {
+                while (true)
+                    q.dequeue();
+            } catch (const std::out_of_range&) {
+                ++woken;
+            }
+        });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    q.close();
+    for (std::thread& t : consumers)
+        t.join();
+    cout << woken.load() << " consumers woken, before the linger : "
+         << (std::chrono::steady_clock::now() - t0 < linger) << "\n";
+
+    // And every producer blocked on a full one. Values still in the queue
+    // can be dequeued after it's closed
+    BlockingQueue<> full(2, 1, linger);
+    full.enqueue(1);
+    full.enqueue(2);
+    std::thread producer([&] {
+        try {
+            full.enqueue(3);
+        } catch (const std::logic_error& e) {
+            std::cerr << e.what() << '\n';
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    full.close();
+    producer.join();
+    cout << full.try_enqueue(4) << " " << full.dequeue() << " "
+         << full.dequeue() << "\n";
+    try {
+        full.dequeue();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+    }
+
+    // A batch bigger than the capacity is capped at it, so values don't
+    // wait for the linger while producers wait for room
+    BlockingQueue<> small(4, 16, linger);
+    t0 = std::chrono::steady_clock::now();
+    std::thread smallProducer([&] {
+        for (int i = 0; i < 12; ++i)
+            small.enqueue(i);
+    });
+    int sum = 0;
+    for (int i = 0; i < 12; ++i)
+        sum += small.dequeue();
+    smallProducer.join();
+    cout << sum << " through a queue of 4, before the linger : "
+         << (std::chrono::steady_clock::now() - t0 < linger) << "\n";
+
+    // A value below the batch threshold reaches a sleeping consumer once
+    // the linger is up
+    BlockingQueue<> lone(16, 16, std::chrono::milliseconds(20));
+    std::thread late([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        lone.enqueue(7);
+    });
+    cout << lone.dequeue() << "\n";
+    late.join();
+}
+
 int main() {
     cout << "Linkedlist tests\n";
     test_list();
+    test_thread_exit();
 
     cout << endl << "Stack tests\n";
-    Stack s;
+    Stack<> s;
     s.push(22);
     s.push(3);
     s.print();
@@ -69,5 +547,63 @@ int main() {
     } catch(const std::exception& e) {
         std::cerr << e.what() << '\n';
     }
+
+    cout << endl << "SPSCQueue tests\n";
+    test_spsc();
+
+    cout << endl << "ConcurrentQueue tests\n";
+    test_concurrent_queue();
+
+    cout << endl << "ConcurrentStack tests\n";
+    test_concurrent_stack();
+
+    cout << endl << "Scheduler tests\n";
+    test_scheduler();
+
+    cout << endl << "IndexedList tests\n";
+    test_indexed();
+
+    cout << endl << "Serialization tests\n";
+    test_serialize();
+
+    cout << endl << "Splice tests\n";
+    Queue<> q {1,2,3,4,5}, q2 {6,7};
+    q.splice(q2);
+    q.print();
+    Queue<> front = q.dequeue_n(3);
+    front.print();
+    q.print();
+    LinkedList<> l {1,2,3,4};
+    LinkedList<> rest = l.splitAt(1);
+    l.print();
+    rest.print();
+    std::pmr::monotonic_buffer_resource arena;
+    Stack<> own(&arena);
+    own.push(9);
+    Stack<> pooled {7,8};
+    try {
+        own.splice(pooled);
+        cout << "splice across resources didn't throw\n";
+    } catch (const std::invalid_argument&) {}
+    own.spliceCopy(pooled);
+    own.print();
+    cout << pooled.size() << "\n";
+
+    cout << endl << "Sort tests\n";
+    test_sort();
+
+    cout << endl << "Block tests\n";
+    test_blocks();
+
+    cout << endl << "BlockingQueue tests\n";
+    test_blocking();
+
+    cout << endl << "Deque tests\n";
+    Deque<> d {2,3};
+    d.push_front(1);
+    d.push_back(4);
+    d.print();
+    cout << d.pop_back() << " " << d.pop_front() << " " << d[1] << "\n";
+    d.print();
     return 0;
 }
\ No newline at end of file